@@ -1,68 +1,291 @@
 #include "client.h"
 #include "SocketTimeoutException.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
 #include <netdb.h>
+#include <poll.h>
 #include <stdexcept>
+#include <string>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <vector>
 
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// One resolved address of a host
+struct Address {
+    sockaddr_storage addr;
+    socklen_t addrlen;
+    int family;
+};
+
+// A connection attempt that is still in progress
+struct Attempt {
+    int fd;
+    Address const* address;
+};
+
+// When connecting to an address last failed, shared by every Client
+std::mutex failures_mutex;
+std::map<std::string, Clock::time_point> failures;
+
+std::string address_key(Address const& address) {
+    return { reinterpret_cast<char const*>(&address.addr), address.addrlen };
+}
+
+void record_failure(Address const& address) {
+    std::lock_guard<std::mutex> lock{ failures_mutex };
+    failures[address_key(address)] = Clock::now();
+}
+
+void record_success(Address const& address) {
+    std::lock_guard<std::mutex> lock{ failures_mutex };
+    failures.erase(address_key(address));
+}
+
 /*
- * Creates a socket for a future server connection
+ * Split `host` as found in a request into a name and a port, which is 80
+ * unless given as in "example.com:8080" or "[::1]:8080"
  */
-Client::Client() {
-    this->socketfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (this->socketfd == -1) {
+void split_host(std::string const& host, std::string& name, std::string& port) {
+    name = host;
+    port = "80";
+    size_t colon = std::string::npos;
+    if (!host.empty() && host.front() == '[') {
+        size_t bracket = host.find(']');
+        if (bracket != std::string::npos) {
+            name = host.substr(1, bracket - 1);
+            colon = host[bracket + 1] == ':' ? bracket + 1 : colon;
+        }
+    } else if (host.find(':') == host.rfind(':')) {
+        colon = host.find(':');
+        name = host.substr(0, colon);
+    }
+    if (colon != std::string::npos && colon + 1 < host.size()) {
+        port = host.substr(colon + 1);
+    }
+}
+
+/*
+ * Resolve every IPv4 and IPv6 address of `name`, in the order to try them:
+ * alternating between the families like Happy Eyeballs (RFC 8305), starting
+ * with the family getaddrinfo prefers, and addresses that failed within
+ * `failure_memory` last
+ */
+std::vector<Address> resolve(std::string const& name,
+                             std::string const& port,
+                             std::chrono::seconds failure_memory) {
+    addrinfo hints{ 0, AF_UNSPEC, SOCK_STREAM, 0, 0, 0, nullptr, nullptr };
+    addrinfo* res;
+    int addrinfo_ret = getaddrinfo(name.c_str(), port.c_str(), &hints, &res);
+    if (addrinfo_ret != 0) {
         throw std::runtime_error{
-            std::string{ "Client: bad fd: " } + strerror(errno),
+            std::string{ "Client: getaddrinfo error: " } +
+                gai_strerror(addrinfo_ret),
         };
     }
+    std::vector<Address> by_family[2];
+    int first_family = res->ai_family;
+    for (addrinfo* info = res; info != nullptr; info = info->ai_next) {
+        if (info->ai_family != AF_INET && info->ai_family != AF_INET6) {
+            continue;
+        }
+        Address address{};
+        std::memcpy(&address.addr, info->ai_addr, info->ai_addrlen);
+        address.addrlen = info->ai_addrlen;
+        address.family = info->ai_family;
+        by_family[info->ai_family == first_family ? 0 : 1].push_back(address);
+    }
+    freeaddrinfo(res);
+
+    std::vector<Address> addresses;
+    for (size_t i = 0; i < std::max(by_family[0].size(), by_family[1].size());
+         i++) {
+        for (std::vector<Address> const& family : by_family) {
+            if (i < family.size()) {
+                addresses.push_back(family[i]);
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock{ failures_mutex };
+    Clock::time_point now = Clock::now();
+    std::stable_partition(
+        addresses.begin(), addresses.end(), [&](Address const& address) {
+            auto failure = failures.find(address_key(address));
+            return failure == failures.end() ||
+                   now - failure->second >= failure_memory;
+        });
+    return addresses;
 }
 
+/*
+ * Start a non-blocking connect to `address`. Returns the socket, or -1 if
+ * the connect failed right away, with `connected` set if it already
+ * succeeded.
+ */
+int start_attempt(Address const& address, bool& connected) {
+    connected = false;
+    int fd = socket(address.family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    int connect_ret = ::connect(
+        fd, reinterpret_cast<sockaddr const*>(&address.addr), address.addrlen);
+    if (connect_ret == 0) {
+        connected = true;
+    } else if (errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace
+
+/*
+ * Prepare for a future server connection, connected with `options`
+ */
+Client::Client(ConnectOptions const& options)
+    : socketfd{ -1 }, options{ options } {}
+
 /*
  * Closes the socket to the server
  */
 Client::~Client() {
-    close(this->socketfd);
+    if (this->socketfd != -1) {
+        close(this->socketfd);
+    }
 }
 
 /*
- * Connect to the server by resolving its IP-address through the `host` string
+ * Connect to the server at `host`, closing any previous connection.
+ * Connects are raced over all its resolved addresses: a new attempt starts
+ * every `stagger`, or as soon as one fails, the first to succeed wins, and
+ * the connect fails if none succeeds before the `deadline`. Addresses that
+ * failed, or lost to an address tried after them, are tried last for
+ * `failure_memory`.
  */
 void Client::connect(std::string const& host) {
-    // Get information about the real server
-    addrinfo hints{ 0, AF_INET, SOCK_STREAM, 0, 0, 0, nullptr, nullptr };
-    addrinfo* res;
+    if (this->socketfd != -1) {
+        close(this->socketfd);
+        this->socketfd = -1;
+    }
+    std::string name;
+    std::string port;
+    split_host(host, name, port);
+    std::vector<Address> addresses =
+        resolve(name, port, this->options.failure_memory);
 
-    // Get address information
-    int addrinfo_ret = getaddrinfo(host.c_str(), nullptr, &hints, &res);
-    if (addrinfo_ret != 0) {
-        throw std::runtime_error{
-            std::string{ "Client: getaddrinfo error: " } +
-                gai_strerror(addrinfo_ret),
-        };
+    Clock::time_point deadline = Clock::now() + this->options.deadline;
+    Clock::time_point next_start = Clock::now();
+    std::vector<Attempt> attempts;
+    size_t next = 0;
+    int winner = -1;
+    Address const* winner_address = nullptr;
+    std::string error = "no address";
+    while (winner == -1) {
+        Clock::time_point now = Clock::now();
+        if (now >= deadline) {
+            error = "connect timed out";
+            for (Attempt const& attempt : attempts) {
+                record_failure(*attempt.address);
+            }
+            break;
+        }
+        if (next < addresses.size() &&
+            (now >= next_start || attempts.empty())) {
+            Address const& address = addresses[next++];
+            bool connected;
+            int fd = start_attempt(address, connected);
+            if (fd == -1) {
+                error = strerror(errno);
+                record_failure(address);
+            } else if (connected) {
+                winner = fd;
+                winner_address = &address;
+            } else {
+                attempts.push_back({ fd, &address });
+                next_start = now + this->options.stagger;
+            }
+            continue;
+        }
+        if (attempts.empty()) {
+            // Every address failed
+            break;
+        }
+
+        // Wait for an attempt to finish, or until the next one is due
+        Clock::time_point wake = deadline;
+        if (next < addresses.size()) {
+            wake = std::min(wake, next_start);
+        }
+        std::vector<pollfd> pollfds;
+        for (Attempt const& attempt : attempts) {
+            pollfds.push_back({ attempt.fd, POLLOUT, 0 });
+        }
+        int timeout =
+            std::chrono::ceil<std::chrono::milliseconds>(wake - now).count();
+        if (poll(pollfds.data(), pollfds.size(), timeout) == -1 &&
+            errno != EINTR) {
+            error = strerror(errno);
+            break;
+        }
+        std::vector<Attempt> pending;
+        for (size_t i = 0; i < attempts.size(); i++) {
+            if (pollfds[i].revents == 0 || winner != -1) {
+                pending.push_back(attempts[i]);
+                continue;
+            }
+            int so_error = 0;
+            socklen_t so_error_len = sizeof(so_error);
+            getsockopt(attempts[i].fd,
+                       SOL_SOCKET,
+                       SO_ERROR,
+                       &so_error,
+                       &so_error_len);
+            if (so_error == 0) {
+                winner = attempts[i].fd;
+                winner_address = attempts[i].address;
+            } else {
+                // Try the next address right away
+                error = strerror(so_error);
+                record_failure(*attempts[i].address);
+                close(attempts[i].fd);
+                next_start = Clock::now();
+            }
+        }
+        attempts.swap(pending);
     }
-    // NOTE: There can be multiple results, but we only care about the first
-    //       one?
-    if (res->ai_family != AF_INET) {
-        throw std::runtime_error{ "Client: bad getaddr info type" };
+    for (Attempt const& attempt : attempts) {
+        if (winner != -1 && attempt.address < winner_address) {
+            // Started before the winner and still not connected, demote it
+            // like a failure so that the next connect does not wait for it
+            record_failure(*attempt.address);
+        }
+        close(attempt.fd);
     }
-    this->bind_data = *reinterpret_cast<sockaddr_in*>(res->ai_addr);
-    this->bind_data.sin_port = htons(80);
-
-    int connect_ret = ::connect(this->socketfd,
-                                reinterpret_cast<sockaddr*>(&this->bind_data),
-                                sizeof(this->bind_data));
-    if (connect_ret == -1) {
+    if (winner == -1) {
         throw std::runtime_error{
-            std::string{ "Client: invalid connect call: " } + strerror(errno),
+            "Client: could not connect to " + host + ": " + error,
         };
     }
+    record_success(*winner_address);
+    this->socketfd = winner;
 
-    // Set timeout to 0.5 seconds
+    // Block again, with a timeout of 0.5 seconds
+    int flags = fcntl(this->socketfd, F_GETFL);
+    fcntl(this->socketfd, F_SETFL, flags & ~O_NONBLOCK);
     timeval timeout{ 0, 500000 };
     int sockopt_ret = setsockopt(
         socketfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
@@ -71,14 +294,14 @@ void Client::connect(std::string const& host) {
             std::string{ "Client: error setting timeout: " } + strerror(errno),
         };
     }
-    freeaddrinfo(res);
 }
 
 /*
  * Send data in `chunk` to the currently connected server
  */
 void Client::send(std::vector<uint8_t> const& chunk) {
-    ssize_t send_ret = ::send(this->socketfd, chunk.data(), chunk.size(), 0);
+    ssize_t send_ret =
+        ::send(this->socketfd, chunk.data(), chunk.size(), MSG_NOSIGNAL);
     if (send_ret == -1) {
         throw std::runtime_error{
             std::string{ "Client: invalid send call: " } + strerror(errno),
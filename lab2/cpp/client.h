@@ -1,13 +1,20 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
-#include <netinet/in.h>
 #include <string>
 #include <vector>
 
+// How Client::connect races the addresses of a host
+struct ConnectOptions {
+    std::chrono::milliseconds stagger{ 250 };   /* between starting attempts */
+    std::chrono::milliseconds deadline{ 5000 }; /* for the whole connect */
+    std::chrono::seconds failure_memory{ 60 }; /* demote failed addresses */
+};
+
 class Client {
 public:
-    Client();
+    explicit Client(ConnectOptions const& = ConnectOptions{});
     ~Client();
     void connect(std::string const&);
     void send(std::vector<uint8_t> const&);
@@ -15,5 +22,5 @@ public:
 
 private:
     int socketfd;
-    sockaddr_in bind_data;
+    ConnectOptions options;
 };
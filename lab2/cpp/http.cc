@@ -0,0 +1,201 @@
+#include "http.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+/*
+ * Replaces the bytes `original` with the ones in `replacer`
+ * on replacing it tries updating any `Content-Length` in the same chunk
+ */
+void replace(std::vector<uint8_t>& chunk,
+             std::string const& original,
+             std::string const& replacer) {
+    if (original.empty()) {
+        return;
+    }
+
+    // Return early if this chunk does not begin with "HTTP/1.1 200 OK"
+    std::string resp_startstr{ "HTTP/1.1 200 OK" };
+    std::vector<uint8_t>::iterator resp_start = std::search(
+        chunk.begin(), chunk.end(), resp_startstr.begin(), resp_startstr.end());
+    if (resp_start == chunk.end()) {
+        return;
+    }
+
+    // Find the end of the header section to know where we can start modifying
+    // normal data with search/replace
+    std::string hdr_mark = "\r\n\r\n";
+    std::vector<uint8_t>::iterator it = std::search(
+        chunk.begin(), chunk.end(), hdr_mark.begin(), hdr_mark.end());
+    if (it == chunk.end()) {
+        return;
+    }
+    // The header section is never modified, so its end stays at this offset
+    std::ptrdiff_t hdr_size = it - chunk.begin();
+
+    // Iterate from the start of body section and look for the next instance of
+    // the `original` string in the `chunk` data and replace each instance with
+    // `replacer`
+    std::ptrdiff_t replacements = 0;
+    while (true) {
+        it = std::search(it, chunk.end(), original.begin(), original.end());
+        if (it == chunk.end()) {
+            break;
+        }
+        it = chunk.erase(it, it + original.size());
+        it = chunk.insert(it, replacer.begin(), replacer.end());
+        // Continue after the replacement, which may contain `original`
+        it += replacer.size();
+        replacements++;
+    }
+    std::ptrdiff_t size_diff =
+        replacements * (static_cast<std::ptrdiff_t>(replacer.size()) -
+                        static_cast<std::ptrdiff_t>(original.size()));
+    if (size_diff == 0) {
+        // No need to modify Content-Length header, return early
+        return;
+    }
+
+    // Find Content-Length in the header section of the chunk
+    std::vector<uint8_t>::iterator hdr_end = chunk.begin() + hdr_size;
+    std::string conlen_hdr = "Content-Length: ";
+    std::vector<uint8_t>::iterator conlen_start = std::search(
+        chunk.begin(), hdr_end, conlen_hdr.begin(), conlen_hdr.end());
+    if (conlen_start == hdr_end) {
+        return;
+    }
+    conlen_start += conlen_hdr.length(); // Seek to content length digits
+
+    // Find the end of Content-Length header, which is at the latest where the
+    // header section ends
+    std::string end_of_header = "\r\n";
+    std::vector<uint8_t>::iterator conlen_end = std::search(
+        conlen_start, chunk.end(), end_of_header.begin(), end_of_header.end());
+
+    // Extract Content-Length digit, leave a malformed one as it is
+    std::string conlen_str = std::string{ conlen_start, conlen_end };
+    std::ptrdiff_t conlen;
+    std::from_chars_result parsed = std::from_chars(
+        conlen_str.data(), conlen_str.data() + conlen_str.size(), conlen);
+    if (parsed.ec != std::errc{} ||
+        parsed.ptr != conlen_str.data() + conlen_str.size() || conlen < 0 ||
+        conlen + size_diff < 0) {
+        return;
+    }
+    conlen_str = std::to_string(conlen + size_diff);
+
+    // Replace old content length with new
+    conlen_start = chunk.erase(conlen_start, conlen_end);
+    chunk.insert(conlen_start, conlen_str.begin(), conlen_str.end());
+}
+
+/*
+ * Finds the destination of an HTTP request in a chunk
+ */
+std::string get_host(std::vector<uint8_t> const& chunk) {
+    std::string request_start{ "GET http://" };
+    std::vector<uint8_t>::const_iterator host_start = std::search(
+        chunk.begin(), chunk.end(), request_start.begin(), request_start.end());
+    if (host_start == chunk.end()) {
+        throw std::runtime_error{
+            "Invalid get request, or not first chunk in request",
+        };
+    }
+
+    // Seek to host string
+    host_start += request_start.length();
+    std::vector<uint8_t>::const_iterator host_end =
+        std::find(host_start, chunk.end(), '/');
+    return { host_start, host_end };
+}
+
+/*
+ * Return whether a chunk begins with the bytes in `prefix`
+ */
+bool starts_with(std::vector<uint8_t> const& chunk, std::string const& prefix) {
+    return chunk.size() >= prefix.size() &&
+           std::equal(prefix.begin(), prefix.end(), chunk.begin());
+}
+
+/*
+ * The value of the first header called `name` (lower case) in `headers`,
+ * which begins with "\r\n" and has its names in lower case, or an empty
+ * string if it is missing
+ */
+static std::string header_value(std::string const& headers,
+                                std::string const& name) {
+    size_t start = headers.find("\r\n" + name + ":");
+    if (start == std::string::npos) {
+        return {};
+    }
+    start += name.size() + 3;
+    size_t end = headers.find("\r\n", start);
+    std::string value = headers.substr(start, end - start);
+    size_t first = value.find_first_not_of(" \t");
+    if (first == std::string::npos) {
+        return {};
+    }
+    return value.substr(first, value.find_last_not_of(" \t") + 1 - first);
+}
+
+/*
+ * A key for the response to the GET request in `chunk` when that response can
+ * be shared with concurrent requests that have the same key, or an empty
+ * string when it cannot. The request line and all headers must be in the
+ * chunk, and no header may make the response depend on who asks, on what
+ * they have cached or on a fresh copy: Authorization, Cookie, Range, the
+ * conditional If-* headers, or no-cache and no-store in Cache-Control or
+ * Pragma. A conditional request may get a 304 without a body, which is no
+ * use to a client that has no copy. The key is the URL and the
+ * Accept-Encoding, since that changes the bytes of the response.
+ */
+std::string coalescing_key(std::vector<uint8_t> const& chunk) {
+    if (!starts_with(chunk, "GET http://")) {
+        return {};
+    }
+    std::string request{ chunk.begin(), chunk.end() };
+    size_t line_end = request.find("\r\n");
+    size_t hdr_end = request.find("\r\n\r\n");
+    if (hdr_end == std::string::npos) {
+        return {};
+    }
+    size_t url_end = request.find(' ', 4);
+    if (url_end == std::string::npos || url_end > line_end) {
+        return {};
+    }
+
+    // Header names are case insensitive, values are compared as lower case
+    std::string headers = request.substr(line_end, hdr_end + 2 - line_end);
+    std::transform(headers.begin(),
+                   headers.end(),
+                   headers.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    for (std::string name : { "authorization",
+                              "cookie",
+                              "range",
+                              "if-none-match",
+                              "if-modified-since",
+                              "if-match",
+                              "if-unmodified-since",
+                              "if-range" }) {
+        if (headers.find("\r\n" + name + ":") != std::string::npos) {
+            return {};
+        }
+    }
+    for (std::string name : { "cache-control", "pragma" }) {
+        std::string value = header_value(headers, name);
+        if (value.find("no-cache") != std::string::npos ||
+            value.find("no-store") != std::string::npos) {
+            return {};
+        }
+    }
+    return request.substr(4, url_end - 4) + ' ' +
+           header_value(headers, "accept-encoding");
+}
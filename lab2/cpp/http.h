@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+void replace(std::vector<uint8_t>&, std::string const&, std::string const&);
+std::string get_host(std::vector<uint8_t> const&);
+bool starts_with(std::vector<uint8_t> const&, std::string const&);
+std::string coalescing_key(std::vector<uint8_t> const&);
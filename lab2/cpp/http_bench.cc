@@ -0,0 +1,127 @@
+#include "http.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/******************************************************************************
+ * Microbenchmark of the functions the proxy runs on every chunk.
+ *
+ * Times replace (the three replacements of handle_conversation), get_host and
+ * starts_with on generated requests and responses shaped like the ones the
+ * proxy sees: chunks from 512 bytes up to 64 KiB, and response bodies with no
+ * match, one match per KiB or one match per 64 bytes. replace modifies its
+ * chunk, so every call works on a fresh copy; the `copy` rows time the copy
+ * alone. Prints one CSV row per case, with throughput in bytes of chunk per
+ * second.
+ *
+ * Usage: ./http_bench [seconds per case, default 0.2]
+ * ***************************************************************************/
+
+/*
+ * A "200 OK" response of about `size` bytes whose body has "Smiley" every
+ * `every` bytes, or nowhere if it is 0
+ */
+std::vector<uint8_t> make_response(size_t size, size_t every) {
+    std::string body;
+    std::string filler = "<p>The weather in Uppsala is fine today.</p>\n";
+    size_t next_match = every;
+    while (body.size() + 80 < size) {
+        if (every != 0 && body.size() >= next_match) {
+            body += "Smiley ";
+            next_match += every;
+        } else {
+            body += filler[body.size() % filler.size()];
+        }
+    }
+    std::string header = "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: text/html\r\n"
+                         "Content-Length: " +
+                         std::to_string(body.size()) + "\r\n\r\n";
+    std::string response = header + body;
+    return { response.begin(), response.end() };
+}
+
+/*
+ * A proxied GET request of about `size` bytes, padded with extra headers
+ */
+std::vector<uint8_t> make_request(size_t size) {
+    std::string request = "GET http://zebroid.ida.liu.se/fakenews/test1.html "
+                          "HTTP/1.1\r\n"
+                          "Host: zebroid.ida.liu.se\r\n"
+                          "User-Agent: Mozilla/5.0\r\n";
+    while (request.size() + 32 < size) {
+        request += "X-Padding: abcdefghijklmnop\r\n";
+    }
+    request += "\r\n";
+    return { request.begin(), request.end() };
+}
+
+// Results of the timed calls go here, so that they are not optimized away
+volatile size_t sink;
+
+/*
+ * Call `function` until `seconds` have passed and print its speed on a chunk
+ * of `bytes` bytes
+ */
+void time_it(std::string const& name,
+             size_t bytes,
+             size_t every,
+             double seconds,
+             std::function<size_t()> const& function) {
+    using Clock = std::chrono::steady_clock;
+    long calls = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0.0;
+    while (elapsed < seconds) {
+        // Read the clock every 16 calls, small chunks take less than it
+        for (int i = 0; i < 16; i++) {
+            sink = function();
+        }
+        calls += 16;
+        elapsed = std::chrono::duration<double>{ Clock::now() - start }.count();
+    }
+    double matches_per_kib = every == 0 ? 0.0 : 1024.0 / every;
+    std::cout << name << ',' << bytes << ',' << matches_per_kib << ','
+              << elapsed / calls * 1e9 << ','
+              << bytes * calls / elapsed / 1e6 << '\n';
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? std::stod(argv[1]) : 0.2;
+    std::cout << "function,bytes,matches_per_kib,ns_per_call,mb_per_sec\n";
+    for (size_t size : { 512, 8192, 65536 }) {
+        for (size_t every : { 0, 1024, 64 }) {
+            std::vector<uint8_t> const response = make_response(size, every);
+            time_it("copy", response.size(), every, seconds, [&] {
+                std::vector<uint8_t> chunk = response;
+                return chunk.size();
+            });
+            time_it("replace", response.size(), every, seconds, [&] {
+                std::vector<uint8_t> chunk = response;
+                replace(chunk, "Smiley", "Trolly");
+                replace(chunk, "smiley.jpg", "trolly.jpg");
+                replace(chunk, " Stockholm", " Linköping");
+                return chunk.size();
+            });
+            time_it("replace_grow", response.size(), every, seconds, [&] {
+                std::vector<uint8_t> chunk = response;
+                replace(chunk, "Smiley", "Smiley face");
+                return chunk.size();
+            });
+        }
+        std::vector<uint8_t> const request = make_request(size);
+        time_it("get_host", request.size(), 0, seconds, [&] {
+            return get_host(request).size();
+        });
+        time_it("starts_with", request.size(), 0, seconds, [&] {
+            return static_cast<size_t>(starts_with(request, "GET http://"));
+        });
+    }
+    return EXIT_SUCCESS;
+}
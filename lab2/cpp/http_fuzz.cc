@@ -0,0 +1,200 @@
+#include "http.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/******************************************************************************
+ * Fuzz target for the functions the proxy runs on every chunk, meant to be
+ * built with AddressSanitizer and UndefinedBehaviorSanitizer.
+ *
+ * An input is split into chunks the way recv may split a stream, at points
+ * taken from its first two bytes, and every chunk goes through starts_with,
+ * get_host, coalescing_key and replace as in handle_conversation, plus
+ * replacements that grow, shrink or contain what they replace. A few
+ * invariants are checked on top of the sanitizers, among them that requests
+ * with headers that make their response personal or conditional are never
+ * coalesced.
+ *
+ * With clang++ this is a libFuzzer target. Other compilers build it with
+ * STANDALONE_FUZZ, which runs the files given as arguments, or without
+ * arguments mutates a few generated requests and responses:
+ *   ./http_fuzz [files...]
+ * ***************************************************************************/
+
+/*
+ * Stop the run with a message, so that the fuzzer records the input
+ */
+void fail(char const* message) {
+    std::cerr << "http_fuzz: " << message << std::endl;
+    std::abort();
+}
+
+/*
+ * Whether the headers of the request in `chunk` include one that keeps
+ * coalescing_key from sharing its response
+ */
+bool has_private_header(std::vector<uint8_t> const& chunk) {
+    std::string request{ chunk.begin(), chunk.end() };
+    size_t hdr_end = request.find("\r\n\r\n");
+    if (hdr_end == std::string::npos) {
+        return false;
+    }
+    request.resize(hdr_end + 2);
+    std::transform(request.begin(),
+                   request.end(),
+                   request.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    for (std::string name : { "authorization",
+                              "cookie",
+                              "range",
+                              "if-none-match",
+                              "if-modified-since",
+                              "if-match",
+                              "if-unmodified-since",
+                              "if-range" }) {
+        if (request.find("\r\n" + name + ":") != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Run one chunk through the functions of http.cc
+ */
+void fuzz_chunk(std::vector<uint8_t> const& chunk) {
+    for (std::string prefix : { "", "G", "GET http://", "HTTP/1.1 200 OK" }) {
+        bool expected =
+            chunk.size() >= prefix.size() &&
+            std::equal(prefix.begin(), prefix.end(), chunk.begin());
+        if (starts_with(chunk, prefix) != expected) {
+            fail("starts_with disagrees with a bounded comparison");
+        }
+    }
+    try {
+        get_host(chunk);
+    } catch (std::runtime_error&) {
+        // Not a proxied request
+    }
+    std::string key = coalescing_key(chunk);
+    if (!key.empty() && (!starts_with(chunk, "GET http://") ||
+                         key.compare(0, 7, "http://") != 0)) {
+        fail("coalescing_key shared a response that is not a proxied GET");
+    }
+    if (!key.empty() && has_private_header(chunk)) {
+        fail("coalescing_key shared a personal or conditional response");
+    }
+
+    std::vector<uint8_t> same = chunk;
+    replace(same, "Smiley", "Smiley");
+    if (same != chunk) {
+        fail("replacing with the same bytes changed the chunk");
+    }
+    std::vector<uint8_t> rewritten = chunk;
+    replace(rewritten, "Smiley", "Trolly");
+    replace(rewritten, "smiley.jpg", "trolly.jpg");
+    replace(rewritten, " Stockholm", " Linköping");
+    replace(rewritten, "Smiley", "Smiley Smiley");
+    replace(rewritten, "Trolly", "T");
+    replace(rewritten, "", "x");
+}
+
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size) {
+    if (size < 2) {
+        return 0;
+    }
+    // Chunks are at most 8192 bytes like the ones the proxy receives, the
+    // first bytes pick how long they are
+    size_t seed = data[0] | data[1] << 8;
+    std::vector<uint8_t> stream{ data + 2, data + size };
+    size_t start = 0;
+    while (start < stream.size()) {
+        seed = seed * 1103515245 + 12345;
+        size_t length = 1 + (seed >> 8) % 8192;
+        size_t end = std::min(stream.size(), start + length);
+        fuzz_chunk({ stream.begin() + start, stream.begin() + end });
+        start = end;
+    }
+    return 0;
+}
+
+#ifdef STANDALONE_FUZZ
+/*
+ * A random mutation of one of a few requests and responses, spliced with the
+ * tokens the functions look for
+ */
+std::vector<uint8_t> random_input(std::mt19937& random) {
+    static std::vector<std::string> const seeds = {
+        "GET http://zebroid.ida.liu.se/fakenews/test1.html HTTP/1.1\r\n"
+        "Host: zebroid.ida.liu.se\r\n\r\n",
+        "GET http://zebroid.ida.liu.se/fakenews/test1.html HTTP/1.1\r\n"
+        "Host: zebroid.ida.liu.se\r\nIf-None-Match: \"abc\"\r\n"
+        "If-Modified-Since: Mon, 19 Oct 2026 12:00:00 GMT\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 37\r\n\r\n"
+        "Smiley from Stockholm <img smiley.jpg>",
+        "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\nSmiley Smiley",
+    };
+    static std::vector<std::string> const tokens = {
+        "Smiley", "smiley.jpg", " Stockholm", "HTTP/1.1 200 OK",
+        "\r\n",   "\r\n\r\n",   "Content-Length: ", "GET http://",
+        "/",      "-1",         "99999999999999999999999", "0",
+        "Cookie: a=b", "Cache-Control: no-cache", "Accept-Encoding: gzip",
+        "\r\nIf-None-Match: \"abc\"", "\r\nif-modified-since: x",
+        "\r\nIf-Match: *", "\r\nIf-Unmodified-Since: x", "\r\nIf-Range: x",
+    };
+    std::string input = seeds[random() % seeds.size()];
+    int mutations = random() % 8;
+    for (int i = 0; i < mutations; i++) {
+        size_t at = random() % (input.size() + 1);
+        switch (random() % 4) {
+        case 0: {
+            input.insert(at, tokens[random() % tokens.size()]);
+        } break;
+        case 1: {
+            input.erase(at, random() % 16);
+        } break;
+        case 2: {
+            if (at < input.size()) {
+                input[at] = static_cast<char>(random());
+            }
+        } break;
+        default: {
+            input.resize(at);
+        } break;
+        }
+    }
+    uint16_t split = static_cast<uint16_t>(random());
+    input.insert(0, { static_cast<char>(split & 0xFF),
+                      static_cast<char>(split >> 8) });
+    return { input.begin(), input.end() };
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            std::ifstream file{ argv[i], std::ios::binary };
+            std::vector<uint8_t> input{ std::istreambuf_iterator<char>{ file },
+                                        std::istreambuf_iterator<char>{} };
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+        }
+        return EXIT_SUCCESS;
+    }
+    std::mt19937 random{ 1 };
+    for (int i = 0; i < 200000; i++) {
+        std::vector<uint8_t> input = random_input(random);
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    std::cout << "200000 random inputs passed" << std::endl;
+    return EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,125 @@
+#include "in_flight.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+SharedResponse::SharedResponse(size_t max_bytes) : max_bytes{ max_bytes } {}
+
+/*
+ * Add the next chunk of the response and wake the conversations waiting
+ * for it. Returns true the first time more than max_bytes are kept, the
+ * caller then closes the response with InFlightTable::close
+ */
+bool SharedResponse::append(std::vector<uint8_t> const& chunk) {
+    bool overflow;
+    {
+        std::lock_guard<std::mutex> lock{ this->mutex };
+        this->chunks.push_back(chunk);
+        this->bytes += chunk.size();
+        this->drop_old();
+        overflow = !this->overflowed && this->bytes > this->max_bytes;
+        this->overflowed |= overflow;
+    }
+    this->changed.notify_all();
+    return overflow;
+}
+
+/*
+ * No more conversations join the response, so the chunks it keeps can be
+ * limited to max_bytes
+ */
+void SharedResponse::close() {
+    std::lock_guard<std::mutex> lock{ this->mutex };
+    this->closed = true;
+    this->drop_old();
+}
+
+/*
+ * Once closed, drop the oldest chunks beyond max_bytes. The newest chunk is
+ * always kept
+ */
+void SharedResponse::drop_old() {
+    while (this->closed && this->chunks.size() > 1 &&
+           this->bytes > this->max_bytes) {
+        this->bytes -= this->chunks.front().size();
+        this->chunks.pop_front();
+        this->first++;
+    }
+}
+
+/*
+ * Mark the end of the response, no chunks follow
+ */
+void SharedResponse::finish() {
+    {
+        std::lock_guard<std::mutex> lock{ this->mutex };
+        this->finished = true;
+    }
+    this->changed.notify_all();
+}
+
+/*
+ * Wait for chunk number `index` and copy it to `chunk`. Returns false if the
+ * response finished before it, or if it was already dropped because the
+ * caller fell more than max_bytes behind
+ */
+bool SharedResponse::get(size_t index, std::vector<uint8_t>& chunk) {
+    std::unique_lock<std::mutex> lock{ this->mutex };
+    this->changed.wait(lock, [&] {
+        return index < this->first + this->chunks.size() || this->finished;
+    });
+    if (index < this->first || index >= this->first + this->chunks.size()) {
+        return false;
+    }
+    chunk = this->chunks[index - this->first];
+    return true;
+}
+
+InFlightTable::InFlightTable(size_t max_bytes) : max_bytes{ max_bytes } {}
+
+/*
+ * The response being fetched for `key`. If there is none, a new one is
+ * added and `leader` is set: the caller then fetches it, and calls finish
+ * when it is done
+ */
+std::shared_ptr<SharedResponse> InFlightTable::join(std::string const& key,
+                                                    bool& leader) {
+    std::lock_guard<std::mutex> lock{ this->mutex };
+    std::shared_ptr<SharedResponse>& response = this->responses[key];
+    leader = response == nullptr;
+    if (leader) {
+        response = std::make_shared<SharedResponse>(this->max_bytes);
+    }
+    return response;
+}
+
+/*
+ * Let no more conversations join `response` for `key`, later requests for
+ * `key` start a new fetch
+ */
+void InFlightTable::close(std::string const& key,
+                          std::shared_ptr<SharedResponse> const& response) {
+    {
+        std::lock_guard<std::mutex> lock{ this->mutex };
+        auto it = this->responses.find(key);
+        if (it != this->responses.end() && it->second == response) {
+            this->responses.erase(it);
+        }
+    }
+    response->close();
+}
+
+/*
+ * End the fetch of `response` for `key`. Conversations that already joined
+ * get the rest of it, later requests for `key` start a new fetch
+ */
+void InFlightTable::finish(std::string const& key,
+                           std::shared_ptr<SharedResponse> const& response) {
+    this->close(key, response);
+    response->finish();
+}
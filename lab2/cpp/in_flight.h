@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The rewritten chunks of one response, as they arrive from the real server.
+// Once more than `max_bytes` arrived it is closed to new conversations, and
+// only the chunks of the last `max_bytes` are kept.
+class SharedResponse {
+public:
+    explicit SharedResponse(size_t);
+    bool append(std::vector<uint8_t> const&);
+    void close();
+    void finish();
+    bool get(size_t, std::vector<uint8_t>&);
+
+private:
+    void drop_old();
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> chunks;
+    size_t const max_bytes;
+    size_t first{ 0 }; /* index of the oldest chunk kept */
+    size_t bytes{ 0 }; /* in the chunks kept */
+    bool overflowed{ false };
+    bool closed{ false };
+    bool finished{ false };
+};
+
+// The responses being fetched, by coalescing_key, shared by every conversation
+class InFlightTable {
+public:
+    explicit InFlightTable(size_t);
+    std::shared_ptr<SharedResponse> join(std::string const&, bool&);
+    void close(std::string const&, std::shared_ptr<SharedResponse> const&);
+    void finish(std::string const&, std::shared_ptr<SharedResponse> const&);
+
+private:
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<SharedResponse>> responses;
+    size_t const max_bytes; /* of every response, see SharedResponse */
+};
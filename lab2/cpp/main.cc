@@ -1,151 +1,260 @@
 #include "SocketTimeoutException.h"
 #include "client.h"
+#include "http.h"
+#include "in_flight.h"
 #include "server.h"
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <functional>
+#include <getopt.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <sys/types.h>
+#include <thread>
+#include <utility>
 #include <vector>
 
-/*
- * Replaces the bytes `original` with the ones in `replacer`
- * on replacing it tries updating any `Content-Length` in the same chunk
- */
-void replace(std::vector<uint8_t>& chunk,
-             std::string const& original,
-             std::string const& replacer) {
-    // Return early if this chunk does not begin with "HTTP/1.1 200 OK"
-    std::string resp_startstr{ "HTTP/1.1 200 OK" };
-    std::vector<uint8_t>::iterator resp_start = std::search(
-        chunk.begin(), chunk.end(), resp_startstr.begin(), resp_startstr.end());
-    if (resp_start == chunk.end()) {
-        return;
-    }
+// Wait this long after failing to accept or to start a conversation, since
+// the file descriptors or threads it ran out of are only freed by others
+const std::chrono::milliseconds RETRY_DELAY{ 100 };
 
-    // Find the end of the header section to know where we can start modifying
-    // normal data with search/replace
-    std::string hdr_mark = "\r\n\r\n";
-    std::vector<uint8_t>::iterator it = std::search(
-        chunk.begin(), chunk.end(), hdr_mark.begin(), hdr_mark.end());
-    if (it == chunk.end()) {
-        return;
-    }
-    // Iterate from the start of body section and look for the next instance of
-    // the `original` string in the `chunk` data and replace each instance with
-    // `replacer`
-    size_t replacements = 0;
-    while (true) {
-        it = std::search(it, chunk.end(), original.begin(), original.end());
-        if (it == chunk.end()) {
-            break;
-        }
-        it = chunk.erase(it, it + original.size());
-        it = chunk.insert(it, replacer.begin(), replacer.end());
-        replacements++;
-    }
-    if (replacements == 0) {
-        // No need to modify Content-Length header, return early
-        return;
+// Counts the conversations being handled, so that at most `limit` run at once
+class ConversationLimit {
+public:
+    explicit ConversationLimit(size_t limit) : limit{ limit } {}
+
+    // Wait until another conversation may start, and count it
+    void acquire() {
+        std::unique_lock<std::mutex> lock{ mutex };
+        freed.wait(lock, [this] { return running < limit; });
+        running++;
     }
-    size_t size_diff = replacements * (replacer.size() - original.size());
 
-    // Find Content-Length in the chunk
-    std::string conlen_hdr = "Content-Length: ";
-    std::vector<uint8_t>::iterator conlen_start = std::search(
-        chunk.begin(), chunk.end(), conlen_hdr.begin(), conlen_hdr.end());
-    if (conlen_start == chunk.end()) {
-        return;
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            running--;
+        }
+        freed.notify_one();
     }
-    conlen_start += conlen_hdr.length(); // Seek to content length digits
 
-    // Find the end of Content-Length header
-    std::string end_of_header = "\r\n";
-    std::vector<uint8_t>::iterator conlen_end = std::search(
-        conlen_start, chunk.end(), end_of_header.begin(), end_of_header.end());
+private:
+    std::mutex mutex;
+    std::condition_variable freed;
+    size_t const limit;
+    size_t running{ 0 };
+};
 
-    // Extract Content-Length digit
-    std::string conlen_str = std::string{ conlen_start, conlen_end };
-    size_t conlen = std::stoul(conlen_str);
-    conlen_str = std::to_string(conlen + size_diff);
+// Releases a conversation counted by ConversationLimit when it goes out of
+// scope, however the conversation ends
+class ConversationSlot {
+public:
+    explicit ConversationSlot(ConversationLimit& limit) : limit{ limit } {}
+    ConversationSlot(ConversationSlot const&) = delete;
+    ConversationSlot& operator=(ConversationSlot const&) = delete;
+    ~ConversationSlot() { limit.release(); }
 
-    // Replace old content length with new
-    conlen_start = chunk.erase(conlen_start, conlen_end);
-    chunk.insert(conlen_start, conlen_str.begin(), conlen_str.end());
-}
+private:
+    ConversationLimit& limit;
+};
 
 /*
- * Finds the destination of an HTTP request in a chunk
+ * Rewrite a chunk of a response from the real server
  */
-std::string get_host(std::vector<uint8_t> const& chunk) {
-    std::string request_start{ "GET http://" };
-    std::vector<uint8_t>::const_iterator host_start = std::search(
-        chunk.begin(), chunk.end(), request_start.begin(), request_start.end());
-    if (host_start == chunk.end()) {
-        throw std::runtime_error{
-            "Invalid get request, or not first chunk in request",
-        };
-    }
-
-    // Seek to host string
-    host_start += request_start.length();
-    std::vector<uint8_t>::const_iterator host_end =
-        std::find(host_start, chunk.end(), '/');
-    return { host_start, host_end };
+void rewrite(std::vector<uint8_t>& chunk) {
+    replace(chunk, "Smiley", "Trolly");
+    replace(chunk, "smiley.jpg", "trolly.jpg");
+    replace(chunk, " Stockholm", " Linköping");
 }
 
 /*
- * Return whether a chunk begins with the bytes in `prefix`
+ * Send `request` to the real server at `host`, then loop getting data from it,
+ * rewrite it, and pass it to `deliver`. This repeats until the server closes
+ * the connection or its socket times out.
  */
-bool starts_with(std::vector<uint8_t> const& chunk, std::string const& prefix) {
-    return std::equal(prefix.begin(), prefix.end(), chunk.begin());
+template <typename Deliver>
+void fetch(std::string const& host,
+           std::vector<uint8_t> const& request,
+           ConnectOptions const& options,
+           Deliver deliver) {
+    Client client{ options };
+    client.connect(host);
+    client.send(request);
+    try {
+        while (true) {
+            std::vector<uint8_t> chunk = client.recv();
+            if (chunk.empty()) {
+                // The server closed the connection
+                return;
+            }
+            rewrite(chunk);
+            deliver(chunk);
+        }
+    } catch (SocketTimeoutException&) {
+        // Client disconnects in the destructor
+    }
 }
 
 /*
- * Recieve a single chunk from the real client and send it to the real server.
- * Then loop getting data from the real server, modify, and then forward it
- * to the real client. This repeats this until a socket times out.
+ * Recieve requests from the real client until one is a proxied GET request,
+ * then forward the response from the real server to it.
+ * Concurrent requests whose responses can be shared (see coalescing_key) are
+ * coalesced: the first one fetches and rewrites the response once, and the
+ * others get the same chunks as they arrive instead of fetching it again.
  */
-void handle_conversation(Server const& server) {
-    std::vector<uint8_t> chunk;
-    Client client;
-    while (true) {
-        try {
-            chunk = server.recv();
-            if (!starts_with(chunk, "GET http://")) {
-                // Ignore request
-                continue;
+void handle_conversation(Connection browser,
+                         ConnectOptions const& options,
+                         InFlightTable& in_flight) {
+    std::vector<uint8_t> request;
+    try {
+        do {
+            request = browser.recv();
+            if (request.empty()) {
+                // The client closed the connection
+                return;
             }
-            std::string host = get_host(chunk);
-            client.connect(host);
-            client.send(chunk);
-            while (true) {
-                chunk = client.recv();
-                replace(chunk, "Smiley", "Trolly");
-                replace(chunk, "smiley.jpg", "trolly.jpg");
-                replace(chunk, " Stockholm", " Linköping");
-                server.send(chunk);
+        } while (!starts_with(request, "GET http://"));
+    } catch (SocketTimeoutException&) {
+        return;
+    }
+
+    try {
+        std::string host = get_host(request);
+        std::string key = coalescing_key(request);
+        if (key.empty()) {
+            fetch(host, request, options, [&](std::vector<uint8_t> const& c) {
+                browser.send(c);
+            });
+            return;
+        }
+
+        bool leader;
+        std::shared_ptr<SharedResponse> response = in_flight.join(key, leader);
+        if (!leader) {
+            std::vector<uint8_t> chunk;
+            for (size_t i = 0; response->get(i, chunk); i++) {
+                browser.send(chunk);
             }
-        } catch (SocketTimeoutException&) {
-            // Client disconnects in the destructor
             return;
         }
+        // Keep fetching for the others if our own client goes away, and end
+        // their response however the fetch ends
+        bool browser_open = true;
+        try {
+            fetch(host, request, options, [&](std::vector<uint8_t> const& c) {
+                if (response->append(c)) {
+                    // Too large to keep for conversations yet to come
+                    in_flight.close(key, response);
+                }
+                if (browser_open) {
+                    try {
+                        browser.send(c);
+                    } catch (std::runtime_error&) {
+                        browser_open = false;
+                    }
+                }
+            });
+        } catch (...) {
+            in_flight.finish(key, response);
+            throw;
+        }
+        in_flight.finish(key, response);
+    } catch (std::runtime_error& error) {
+        // No address of the host answered in time, or a socket failed, drop
+        // the client
+        std::cerr << error.what() << std::endl;
     }
 }
 
+/*
+ * Handle a conversation counted by `limit`, and uncount it when it ends
+ */
+void limited_conversation(Connection browser,
+                          ConnectOptions const& options,
+                          InFlightTable& in_flight,
+                          ConversationLimit& limit) {
+    ConversationSlot slot{ limit };
+    handle_conversation(std::move(browser), options, in_flight);
+}
+
 /*
  * Set up a socket for the server to recieve connections,
- * then handle those connections in a loop
+ * then handle each connection on a thread of its own. With `connections`
+ * conversations running, new clients wait in the listen backlog of the
+ * socket until one ends. Failing to accept a client or to start its thread
+ * only drops that client.
+ *
+ * -s --stagger     (ms)  Wait between connects to the next address (250)
+ * -d --deadline    (ms)  Give up connecting to a host after this (5000)
+ * -c --connections       Conversations handled at once (256)
+ * -b --shared-bytes      Bytes kept of a coalesced response (8 MiB), see
+ *                        SharedResponse
  */
-int main() {
+int main(int argc, char* argv[]) {
+    ConnectOptions options;
+    size_t connections = 256;
+    size_t shared_bytes = 8 << 20;
+    option long_options[] = {
+        { "stagger", required_argument, nullptr, 's' },
+        { "deadline", required_argument, nullptr, 'd' },
+        { "connections", required_argument, nullptr, 'c' },
+        { "shared-bytes", required_argument, nullptr, 'b' },
+        { nullptr, 0, nullptr, 0 },
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:d:c:b:", long_options, nullptr)) !=
+           -1) {
+        switch (opt) {
+        case 's': {
+            options.stagger = std::chrono::milliseconds{ std::stol(optarg) };
+        } break;
+        case 'd': {
+            options.deadline = std::chrono::milliseconds{ std::stol(optarg) };
+        } break;
+        case 'c': {
+            connections = std::stoul(optarg);
+        } break;
+        case 'b': {
+            shared_bytes = std::stoul(optarg);
+        } break;
+        default: {
+            std::cerr << argv[0]
+                      << " -s, --stagger <ms> -d, --deadline <ms>"
+                         " -c, --connections <count>"
+                         " -b, --shared-bytes <bytes>"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        }
+    }
+
     Server server{ 8080 };
+    InFlightTable in_flight{ shared_bytes };
+    ConversationLimit limit{ std::max<size_t>(connections, 1) };
     while (true) {
-        server.connect();
-        handle_conversation(server);
-        server.disconnect();
+        limit.acquire();
+        try {
+            std::thread{ limited_conversation,
+                         server.accept(),
+                         std::cref(options),
+                         std::ref(in_flight),
+                         std::ref(limit) }
+                .detach();
+        } catch (std::runtime_error& error) {
+            // Out of file descriptors or threads, or the client gave up
+            // before it was accepted (std::system_error is a runtime_error)
+            std::cerr << error.what() << std::endl;
+            limit.release();
+            std::this_thread::sleep_for(RETRY_DELAY);
+        }
     }
     return EXIT_SUCCESS;
 }
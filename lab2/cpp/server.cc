@@ -45,7 +45,8 @@ Server::Server(uint16_t port) {
         };
     }
 
-    if (listen(socketfd, 5) == -1) {
+    // Room for a crowd of browsers connecting at once
+    if (listen(socketfd, SOMAXCONN) == -1) {
         throw std::runtime_error{
             std::string{ "Server: failed listen call: " } + strerror(errno),
         };
@@ -53,21 +54,21 @@ Server::Server(uint16_t port) {
 }
 
 /*
- * Closes the socket to the client as well as the socket for recieving new
- * connections
+ * Closes the socket for recieving new connections, connections that were
+ * accepted stay open
  */
 Server::~Server() {
-    close(this->client_socket);
     close(this->socketfd);
 }
 
 /*
- * Connect to the client (web browser)
+ * Wait for the next client (web browser) to connect
  */
-void Server::connect() {
-    unsigned int addrlen = sizeof(this->bind_data);
-    this->client_socket = accept(
-        socketfd, reinterpret_cast<sockaddr*>(&this->bind_data), &addrlen);
+Connection Server::accept() const {
+    sockaddr_in client_data;
+    unsigned int addrlen = sizeof(client_data);
+    int client_socket = ::accept(
+        socketfd, reinterpret_cast<sockaddr*>(&client_data), &addrlen);
     if (client_socket == -1) {
         throw std::runtime_error{
             std::string{ "Server: failed accept call: " } + strerror(errno),
@@ -79,25 +80,41 @@ void Server::connect() {
     int sockopt_ret = setsockopt(
         client_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
     if (sockopt_ret == -1) {
+        close(client_socket);
         throw std::runtime_error{
             std::string{ "Server: error setting timeout: " } + strerror(errno),
         };
     }
+    return Connection{ client_socket };
+}
+
+/*
+ * Take over the socket of an accepted client
+ */
+Connection::Connection(int client_socket) : client_socket{ client_socket } {}
+
+Connection::Connection(Connection&& other) noexcept
+    : client_socket{ other.client_socket } {
+    other.client_socket = -1;
 }
 
 /*
  * Closes the socket to the client
  */
-void Server::disconnect() {
-    close(this->client_socket);
+Connection::~Connection() {
+    if (this->client_socket != -1) {
+        close(this->client_socket);
+    }
 }
 
 /*
- * Send data in `chunk` to the currently connected client
+ * Send data in `chunk` to the client
+ * A client that went away is an error instead of a SIGPIPE, which would stop
+ * the conversations of every other client too
  */
-void Server::send(std::vector<uint8_t> const& chunk) const {
-    ssize_t send_ret =
-        ::send(this->client_socket, chunk.data(), chunk.size(), 0);
+void Connection::send(std::vector<uint8_t> const& chunk) const {
+    ssize_t send_ret = ::send(
+        this->client_socket, chunk.data(), chunk.size(), MSG_NOSIGNAL);
     if (send_ret == -1) {
         throw std::runtime_error{
             std::string{ "Server: invalid send call " } + strerror(errno),
@@ -106,10 +123,10 @@ void Server::send(std::vector<uint8_t> const& chunk) const {
 }
 
 /*
- * Recieve data from the currently connected client
+ * Recieve data from the client
  * If the socket times out, throw a SocketTimeoutException
  */
-std::vector<uint8_t> Server::recv() const {
+std::vector<uint8_t> Connection::recv() const {
     std::vector<uint8_t> chunk(8192);
     ssize_t bytes_read =
         ::recv(this->client_socket, chunk.data(), chunk.size(), 0);
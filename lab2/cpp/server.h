@@ -4,17 +4,28 @@
 #include <netinet/in.h>
 #include <vector>
 
+// One accepted connection from a client (web browser)
+class Connection {
+public:
+    explicit Connection(int);
+    Connection(Connection&&) noexcept;
+    Connection(Connection const&) = delete;
+    Connection& operator=(Connection const&) = delete;
+    ~Connection();
+    void send(std::vector<uint8_t> const&) const;
+    std::vector<uint8_t> recv() const;
+
+private:
+    int client_socket;
+};
+
 class Server {
 public:
     Server(uint16_t);
     ~Server();
-    void connect();
-    void disconnect();
-    void send(std::vector<uint8_t> const&) const;
-    std::vector<uint8_t> recv() const;
+    Connection accept() const;
 
 private:
     int socketfd;
-    int client_socket;
     sockaddr_in bind_data;
 };
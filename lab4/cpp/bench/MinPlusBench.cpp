@@ -0,0 +1,264 @@
+#include "Cost.h"
+#include "MinPlus.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+/******************************************************************************
+ * Microbenchmark for the min-plus relaxation in RouterNode.
+ *
+ * Relaxes every destination of a node with DEGREE neighbors, for a range of
+ * network sizes, using:
+ *   - reference: the former updateDistanceCosts loop, which fills temporary
+ *                route/first hop vectors for every destination and then
+ *                scans them for the minimum
+ *   - scalar:    minPlusRelaxScalar over the flat distance matrix
+ *   - dispatch:  minPlusRelax, using the widest SIMD version the CPU has
+ *
+ * Then compares dispatch with minPlusRelaxFixed, which RouterNode uses for
+ * networks of up to MAX_FIXED_NODES nodes, at those sizes and over Cost, and
+ * dispatch over int costs with dispatch over the 16 bit costs of the default
+ * Cost.
+ *
+ * Usage: ./MinPlusBench [degree]
+ * ***************************************************************************/
+
+using namespace std;
+
+static const int INFINITY_COST = 999;
+
+static void relaxReference(vector<int> const& costs,
+                           vector<vector<int>> const& distances,
+                           vector<int>& best,
+                           vector<int>& bestSlot) {
+    for (size_t target = 0; target < best.size(); target++) {
+        vector<int> targetRoutes;
+        vector<int> targetFirstHops;
+        targetRoutes.reserve(costs.size());
+        targetFirstHops.reserve(costs.size());
+        for (size_t slot = 0; slot < costs.size(); slot++) {
+            targetRoutes.push_back(costs[slot] + distances[slot][target]);
+            targetFirstHops.push_back(static_cast<int>(slot));
+        }
+        int minCost = INFINITY_COST;
+        int minFirstHop = -1;
+        for (size_t i = 0; i < targetRoutes.size(); i++) {
+            if (targetRoutes[i] < minCost) {
+                minCost = targetRoutes[i];
+                minFirstHop = targetFirstHops[i];
+            }
+        }
+        best[target] = minCost;
+        bestSlot[target] = minFirstHop;
+    }
+}
+
+/*
+ * Run `fn` repeatedly for roughly 0.2 seconds and return ns per call. The
+ * clock is read every 16 calls, so it does not dominate small sizes.
+ */
+template <typename Fn> static double timeIt(Fn fn) {
+    using clock = chrono::steady_clock;
+    long iterations = 0;
+    auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+    do {
+        for (int i = 0; i < 16; i++) {
+            fn();
+        }
+        iterations += 16;
+        elapsed = clock::now() - start;
+    } while (elapsed < chrono::milliseconds(200));
+    return chrono::duration<double, nano>(elapsed).count() / iterations;
+}
+
+/*
+ * Time dispatch and fixed relaxation of all `Nodes` destinations of a node
+ * with `degree` neighbors, and print one line. Costs are of type Cost, like
+ * in RouterNode.
+ */
+template <size_t Nodes> static bool benchFixed(size_t degree) {
+    degree = min(degree, Nodes - 1);
+    vector<Cost> costs(degree);
+    vector<Cost> flat(degree * Nodes);
+    for (size_t s = 0; s < degree; s++) {
+        costs[s] = 1 + rand() % 20;
+        for (size_t d = 0; d < Nodes; d++) {
+            flat[s * Nodes + d] =
+                rand() % 8 == 0 ? INFINITY_COST : rand() % 200;
+        }
+    }
+
+    vector<Cost> best(Nodes), fixedBest(Nodes);
+    vector<int> bestSlot(Nodes), fixedSlot(Nodes);
+    double dispatch = timeIt([&] {
+        minPlusRelax(costs.data(),
+                     flat.data(),
+                     degree,
+                     Nodes,
+                     0,
+                     Nodes,
+                     INFINITY_COST,
+                     best.data(),
+                     bestSlot.data());
+    });
+    double fixedWidth = timeIt([&] {
+        minPlusRelaxFixed<Nodes>(costs.data(),
+                                 flat.data(),
+                                 degree,
+                                 INFINITY_COST,
+                                 fixedBest.data(),
+                                 fixedSlot.data());
+    });
+    if (best != fixedBest || bestSlot != fixedSlot) {
+        cerr << "Mismatch of the fixed version at " << Nodes << " nodes"
+             << endl;
+        return false;
+    }
+    cout << setw(8) << Nodes << setprecision(1) << setw(15) << dispatch
+         << setw(15) << fixedWidth << setprecision(2) << setw(10)
+         << dispatch / fixedWidth << endl;
+    return true;
+}
+
+/*
+ * Time dispatch over int and over 16 bit costs for all destinations of a node
+ * with `degree` neighbors and `nodes` nodes, and print one line
+ */
+static bool benchWidth(size_t degree, size_t nodes) {
+    vector<int> costs(degree);
+    vector<int> flat(degree * nodes);
+    for (size_t s = 0; s < degree; s++) {
+        costs[s] = 1 + rand() % 20;
+        for (size_t d = 0; d < nodes; d++) {
+            flat[s * nodes + d] =
+                rand() % 8 == 0 ? INFINITY_COST : rand() % 200;
+        }
+    }
+    vector<uint16_t> costs16(costs.begin(), costs.end());
+    vector<uint16_t> flat16(flat.begin(), flat.end());
+
+    vector<int> best(nodes), bestSlot(nodes);
+    vector<uint16_t> best16(nodes);
+    vector<int> bestSlot16(nodes);
+    double wide = timeIt([&] {
+        minPlusRelax(costs.data(),
+                     flat.data(),
+                     degree,
+                     nodes,
+                     0,
+                     nodes,
+                     INFINITY_COST,
+                     best.data(),
+                     bestSlot.data());
+    });
+    double narrow = timeIt([&] {
+        minPlusRelax(costs16.data(),
+                     flat16.data(),
+                     degree,
+                     nodes,
+                     0,
+                     nodes,
+                     INFINITY_COST,
+                     best16.data(),
+                     bestSlot16.data());
+    });
+    if (!equal(best.begin(), best.end(), best16.begin()) ||
+        bestSlot != bestSlot16) {
+        cerr << "Mismatch of the 16 bit version at " << nodes << " nodes"
+             << endl;
+        return false;
+    }
+    cout << setw(8) << nodes << setprecision(0) << setw(15) << wide
+         << setw(15) << narrow << setprecision(2) << setw(10) << wide / narrow
+         << endl;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    size_t degree = argc > 1 ? strtoul(argv[1], nullptr, 10) : 8;
+    srand(1234);
+
+    cout << "min-plus relaxation, degree " << degree << ", dispatching to "
+         << minPlusImplementation() << '\n';
+    cout << setw(8) << "nodes" << setw(15) << "reference ns" << setw(15)
+         << "scalar ns" << setw(15) << "dispatch ns" << setw(10) << "scalar x"
+         << setw(11) << "dispatch x" << '\n';
+    cout << fixed;
+
+    for (size_t nodes = 16; nodes <= 16384; nodes *= 4) {
+        vector<int> costs(degree);
+        vector<vector<int>> nested(degree, vector<int>(nodes));
+        vector<int> flat(degree * nodes);
+        for (size_t s = 0; s < degree; s++) {
+            costs[s] = 1 + rand() % 20;
+            for (size_t d = 0; d < nodes; d++) {
+                // Leave some destinations unreachable through a neighbor
+                int dist = rand() % 8 == 0 ? INFINITY_COST : rand() % 200;
+                nested[s][d] = dist;
+                flat[s * nodes + d] = dist;
+            }
+        }
+
+        vector<int> refBest(nodes), refSlot(nodes);
+        vector<int> best(nodes), bestSlot(nodes);
+        double reference = timeIt(
+            [&] { relaxReference(costs, nested, refBest, refSlot); });
+        double scalar = timeIt([&] {
+            minPlusRelaxScalar(costs.data(),
+                               flat.data(),
+                               degree,
+                               nodes,
+                               0,
+                               nodes,
+                               INFINITY_COST,
+                               best.data(),
+                               bestSlot.data());
+        });
+        double dispatch = timeIt([&] {
+            minPlusRelax(costs.data(),
+                         flat.data(),
+                         degree,
+                         nodes,
+                         0,
+                         nodes,
+                         INFINITY_COST,
+                         best.data(),
+                         bestSlot.data());
+        });
+        if (best != refBest || bestSlot != refSlot) {
+            cerr << "Mismatch against the reference at " << nodes << " nodes"
+                 << endl;
+            return EXIT_FAILURE;
+        }
+        cout << setw(8) << nodes << setprecision(0) << setw(15) << reference
+             << setw(15) << scalar << setw(15) << dispatch << setprecision(2)
+             << setw(10) << reference / scalar << setw(11)
+             << reference / dispatch << endl;
+    }
+
+    cout << '\n'
+         << setw(8) << "nodes" << setw(15) << "dispatch ns" << setw(15)
+         << "fixed ns" << setw(10) << "fixed x" << '\n';
+    bool fixedMatches = benchFixed<3>(degree) && benchFixed<4>(degree) &&
+                        benchFixed<5>(degree) && benchFixed<6>(degree) &&
+                        benchFixed<7>(degree) && benchFixed<8>(degree);
+    if (!fixedMatches) {
+        return EXIT_FAILURE;
+    }
+
+    cout << '\n'
+         << setw(8) << "nodes" << setw(15) << "int ns" << setw(15)
+         << "uint16 ns" << setw(10) << "uint16 x" << '\n';
+    for (size_t nodes = 16; nodes <= 16384; nodes *= 4) {
+        if (!benchWidth(degree, nodes)) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,787 @@
+#include "Renumbering.h"
+#include "Router.h"
+#include "RouterSimulator.h"
+#include "Topology.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <getopt.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/******************************************************************************
+ * Convergence benchmark for the distance vector routing simulator.
+ *
+ * Sweeps RouterSimulator over random connected topologies of doubling size,
+ * for every protocol, scenario, degree, poisoned reverse setting, horizon,
+ * infinity, path vector setting, update delay, loss, node order and seed, and
+ * prints one CSV row or JSON object per run:
+ *   - wall time of the simulation
+ *   - simulated time of the last distance vector change (convergence) and of
+ *     the last event
+ *   - packets, cost entries and bytes sent, packets lost and dropped by the
+ *     link model, and events processed
+ *   - the number of (node, destination) pairs whose final cost or first hop
+ *     disagrees with all-pairs Dijkstra on the final topology
+ *   - the number of links between nodes of different partitions, with more
+ *     than one thread
+ *
+ * With a node order the topology is simulated with the IDs of a Renumbering,
+ * and the results are checked with the original IDs.
+ *
+ * Every simulator has its own configuration and random state, so the runs are
+ * spread over a pool of --jobs threads. Output stays in the order of the grid
+ * whatever the number of jobs, but wall times of concurrent runs include their
+ * contention for the CPU. With --summary the runs of each configuration are
+ * aggregated over all seeds into one row instead.
+ *
+ * Scenarios:
+ *   static     no link changes
+ *   change     nodes/16 random links get a new random cost
+ *   fail       nodes/16 random links go down (cost INFINITY)
+ *   churn      nodes/16 random changes, failures and recoveries per 100 time
+ *              units on average, streamed from RandomChurn (not by default)
+ *
+ * Lists are comma separated, like "-p true,false".
+ *
+ * -n --min-nodes          (int)             Smallest topology (default 8)
+ * -N --max-nodes          (int)             Largest topology (default 256)
+ * -c --scenarios          (list)            Scenarios (static,change,fail)
+ * -d --degree             (list)            Average node degrees (default 4)
+ * -r --runs               (int)             Seeds per configuration (3)
+ * -s --first-seed         (long)            First seed (default 1)
+ * -p --poisonreverse      (list)            Poisoned reverse (default false)
+ * -P --protocol           (list)            dv and/or ls (default dv)
+ * -z --horizon            (list)            lab, split, poison (default lab)
+ * -i --infinity           (list)            Costs of unreachable routes (999)
+ * -V --path-vector        (list)            Path vector loop detection (false)
+ * -D --update-delay       (list)            Update merge delays (default 0)
+ * -H --holddown          (double)           Hold-down time (default 0)
+ * -m --min-interval      (double)           Least time between updates (0)
+ * -l --latency           (double)           Link latency, 0 for random delays
+ * -b --bandwidth         (double)           Link bytes per time unit (0)
+ * -q --queue              (int)             Packets queued per link (0)
+ * -x --loss               (list)            Packet loss probabilities (0)
+ * -o --order              (list)            Node orders none, bfs, rcm (none)
+ * -e --refresh           (double)           Resend all routes this often (0)
+ * -j --threads            (int)             Threads per simulation (1)
+ * -J --jobs               (int)             Concurrent simulations (1)
+ * -S --summary                              Aggregate runs over seeds
+ * -f --format           csv/json            Output format (default csv)
+ *
+ * Exits with a failure status if any run disagrees with Dijkstra, which runs
+ * with loss do unless routers refresh their routes until the end. The lab's
+ * poisoned reverse keeps advertising INFINITY for the far end of a changed
+ * link until the node sends its next update, which may never come, so its
+ * runs with link changes are expected to disagree. Their mismatches are
+ * reported but do not fail the benchmark.
+ * ***************************************************************************/
+
+using namespace std;
+
+namespace {
+
+const int MAX_LINK_COST = 10;
+const int INFINITY_COST = 999; /* failed links, taken as any INFINITY */
+
+// One point of the parameter grid
+struct Run {
+    string protocol;
+    string scenario;
+    int nodes;
+    int degree;
+    bool poisonReverse;
+    string horizon;
+    int infinity;
+    bool pathVector;
+    double updateDelay;
+    double holddown;
+    double minInterval;
+    double latency;
+    double bandwidth;
+    int queueLimit;
+    double loss;
+    double refresh;
+    string order;
+    long seed;
+};
+
+struct Result {
+    Run run;
+    size_t links;
+    size_t cutLinks;
+    double wallMs;
+    double endTime;
+    SimulationStats stats;
+    long mismatches;
+};
+
+// Results of the runs of one configuration, over all seeds
+struct Summary {
+    Run run;
+    int runs{ 0 };
+    double wallMs{ 0.0 };
+    double convergenceTime{ 0.0 };
+    double minConvergenceTime{ 0.0 };
+    double maxConvergenceTime{ 0.0 };
+    double packets{ 0.0 };
+    double lost{ 0.0 };
+    double dropped{ 0.0 };
+    double bytes{ 0.0 };
+    double events{ 0.0 };
+    long mismatches{ 0 };
+};
+
+vector<string> splitList(string const& list) {
+    vector<string> items;
+    istringstream stream{ list };
+    string item;
+    while (getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+/*
+ * Shortest path costs from every node, ignoring links of cost `infinity`.
+ */
+vector<vector<int>> allPairsDijkstra(Topology const& topology, int infinity) {
+    int n = topology.numNodes();
+    vector<vector<int>> dist(n, vector<int>(n, infinity));
+    using Entry = pair<int, int>;
+    for (int source = 0; source < n; source++) {
+        vector<int>& d = dist[source];
+        priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+        d[source] = 0;
+        queue.push({ 0, source });
+        while (!queue.empty()) {
+            auto [cost, node] = queue.top();
+            queue.pop();
+            if (cost > d[node]) {
+                continue;
+            }
+            for (auto const& [next, linkcost] : topology.links(node)) {
+                if (linkcost >= infinity) {
+                    continue;
+                }
+                int through = cost + linkcost;
+                if (through < d[next]) {
+                    d[next] = through;
+                    queue.push({ through, next });
+                }
+            }
+        }
+        // Routes costing INFINITY or more are unreachable to the nodes too
+        for (int& cost : d) {
+            cost = min(cost, infinity);
+        }
+    }
+    return dist;
+}
+
+/*
+ * The number of links between nodes of different partitions when the
+ * simulator splits `topology` over `threads` threads
+ */
+size_t cutLinks(Topology const& topology, int threads) {
+    vector<int> partitions =
+        topology.partition(max(1, min(threads, topology.numNodes())));
+    size_t cut = 0;
+    for (int from = 0; from < topology.numNodes(); from++) {
+        for (auto const& [to, cost] : topology.links(from)) {
+            cut += from < to && partitions[from] != partitions[to];
+        }
+    }
+    return cut;
+}
+
+/*
+ * Count (node, destination) pairs where the node's cost differs from the
+ * shortest path, or where its first hop is not on a shortest path. The
+ * topology and the truth have the original IDs of `renumbering`.
+ */
+long verify(RouterSimulator const& sim,
+            Renumbering const& renumbering,
+            Topology const& topology,
+            vector<vector<int>> const& truth) {
+    long mismatches = 0;
+    for (int node = 0; node < topology.numNodes(); node++) {
+        Router const& router = sim.getNode(renumbering.renumbered(node));
+        for (int dest = 0; dest < topology.numNodes(); dest++) {
+            int renumberedDest = renumbering.renumbered(dest);
+            if (router.getDistance(renumberedDest) != truth[node][dest]) {
+                mismatches++;
+                continue;
+            }
+            if (dest == node || truth[node][dest] == sim.INFINITY) {
+                continue;
+            }
+            int hop = router.getFirstHop(renumberedDest);
+            hop = hop == -1 ? -1 : renumbering.original(hop);
+            int linkcost = hop == -1 ? -1 : topology.cost(node, hop);
+            if (linkcost == -1 ||
+                linkcost + truth[hop][dest] != truth[node][dest]) {
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+/*
+ * Whether `run` uses the lab's poisoned reverse with link changes, which can
+ * leave stale routes, see the top of this file
+ */
+bool staleRoutesExpected(Run const& run) {
+    return run.protocol == "dv" && run.horizon == "lab" && run.poisonReverse &&
+           run.scenario != "static";
+}
+
+Result runOnce(Run const& run, int threads) {
+    Topology topology =
+        Topology::random(run.nodes, run.degree, MAX_LINK_COST, run.seed);
+    int count = max(1, run.nodes / 16);
+    vector<LinkChange> changes;
+    if (run.scenario == "change") {
+        changes = topology.randomChanges(count, 1, MAX_LINK_COST, run.seed);
+    } else if (run.scenario == "fail") {
+        changes = topology.randomChanges(
+            count, INFINITY_COST, INFINITY_COST, run.seed);
+    }
+
+    SimulatorConfig config;
+    config.NUM_NODES = run.nodes;
+    config.POISONREVERSE = run.poisonReverse;
+    config.HORIZON = run.horizon == "split"    ? Horizon::Split
+                     : run.horizon == "poison" ? Horizon::Poison
+                                               : Horizon::Lab;
+    config.INFINITY = run.infinity;
+    config.PATHVECTOR = run.pathVector;
+    config.SEED = run.seed;
+    config.TRACE = 0;
+    config.THREADS = threads;
+    config.PROTOCOL =
+        run.protocol == "ls" ? Protocol::LinkState : Protocol::DistanceVector;
+    config.UPDATEDELAY = run.updateDelay;
+    config.HOLDDOWN = run.holddown;
+    config.MININTERVAL = run.minInterval;
+    config.LATENCY = run.latency;
+    config.BANDWIDTH = run.bandwidth;
+    config.QUEUELIMIT = run.queueLimit;
+    config.LOSS = run.loss;
+    config.REFRESH = run.refresh;
+
+    NodeOrder order = run.order == "bfs"   ? NodeOrder::BFS
+                      : run.order == "rcm" ? NodeOrder::RCM
+                                           : NodeOrder::None;
+    auto start = chrono::steady_clock::now();
+    Renumbering renumbering{ topology, order };
+    Topology renumbered = renumbering.renumbered(topology);
+    RouterSimulator sim{ config, renumbered, renumbering.renumbered(changes) };
+    if (run.scenario == "churn") {
+        sim.streamLinkChanges(
+            renumbering.renumbered(make_unique<RandomChurn>(topology,
+                                                            count / 100.0,
+                                                            100.0,
+                                                            1000.0,
+                                                            MAX_LINK_COST,
+                                                            INFINITY_COST,
+                                                            run.seed)));
+    }
+    sim.runSimulation();
+    double wallMs = chrono::duration<double, milli>(
+                        chrono::steady_clock::now() - start)
+                        .count();
+
+    Result result{ run,
+                   topology.numLinks(),
+                   cutLinks(renumbered, threads),
+                   wallMs,
+                   sim.getClockTime(),
+                   sim.getStats(),
+                   0 };
+    Topology final = renumbering.original(sim.getTopology());
+    result.mismatches = verify(
+        sim, renumbering, final, allPairsDijkstra(final, sim.INFINITY));
+    return result;
+}
+
+void addToSummary(Summary& summary, Result const& r) {
+    double convergence = r.stats.convergenceTime;
+    if (summary.runs == 0) {
+        summary.run = r.run;
+        summary.minConvergenceTime = convergence;
+        summary.maxConvergenceTime = convergence;
+    }
+    summary.runs++;
+    summary.wallMs += r.wallMs;
+    summary.convergenceTime += convergence;
+    summary.minConvergenceTime = min(summary.minConvergenceTime, convergence);
+    summary.maxConvergenceTime = max(summary.maxConvergenceTime, convergence);
+    summary.packets += r.stats.packetsSent;
+    summary.lost += r.stats.packetsLost;
+    summary.dropped += r.stats.packetsDropped;
+    summary.bytes += r.stats.bytesSent;
+    summary.events += r.stats.eventsProcessed;
+    summary.mismatches += r.mismatches;
+}
+
+void printCsvHeader(bool summary) {
+    if (summary) {
+        cout << "protocol,scenario,nodes,degree,poisonreverse,horizon,"
+                "infinity,path_vector,update_delay,"
+                "holddown,min_interval,latency,bandwidth,queue,loss,refresh,"
+                "order,threads,runs,wall_ms,"
+                "convergence_time,min_convergence_time,max_convergence_time,"
+                "packets,lost,dropped,bytes,events,mismatches\n";
+    } else {
+        cout << "protocol,scenario,nodes,degree,poisonreverse,horizon,"
+                "infinity,path_vector,update_delay,"
+                "holddown,min_interval,latency,bandwidth,queue,loss,refresh,"
+                "order,links,cut_links,seed,threads,"
+                "wall_ms,convergence_time,end_time,packets,lost,dropped,"
+                "entries,bytes,events,events_per_sec,mismatches\n";
+    }
+}
+
+void printCsv(Result const& r, int threads) {
+    cout << r.run.protocol << ',' << r.run.scenario << ',' << r.run.nodes << ','
+         << r.run.degree << ',' << boolalpha << r.run.poisonReverse << ','
+         << r.run.horizon << ',' << r.run.infinity << ',' << r.run.pathVector
+         << ',' << r.run.updateDelay << ',' << r.run.holddown << ','
+         << r.run.minInterval << ',' << r.run.latency << ',' << r.run.bandwidth
+         << ',' << r.run.queueLimit << ',' << r.run.loss << ',' << r.run.refresh
+         << ',' << r.run.order << ',' << r.links << ',' << r.cutLinks << ','
+         << r.run.seed << ',' << threads << ',' << r.wallMs << ','
+         << r.stats.convergenceTime << ',' << r.endTime << ','
+         << r.stats.packetsSent << ',' << r.stats.packetsLost << ','
+         << r.stats.packetsDropped << ',' << r.stats.entriesSent << ','
+         << r.stats.bytesSent << ',' << r.stats.eventsProcessed << ','
+         << r.stats.eventsProcessed / (r.wallMs / 1000.0) << ',' << r.mismatches
+         << endl;
+}
+
+/*
+ * Print the means over the runs of a configuration
+ */
+void printCsv(Summary const& s, int threads) {
+    cout << s.run.protocol << ',' << s.run.scenario << ',' << s.run.nodes << ','
+         << s.run.degree << ',' << boolalpha << s.run.poisonReverse << ','
+         << s.run.horizon << ',' << s.run.infinity << ',' << s.run.pathVector
+         << ',' << s.run.updateDelay << ',' << s.run.holddown << ','
+         << s.run.minInterval << ',' << s.run.latency << ',' << s.run.bandwidth
+         << ',' << s.run.queueLimit << ',' << s.run.loss << ',' << s.run.refresh
+         << ',' << s.run.order << ',' << threads << ',' << s.runs << ','
+         << s.wallMs / s.runs << ',' << s.convergenceTime / s.runs << ','
+         << s.minConvergenceTime << ',' << s.maxConvergenceTime << ','
+         << s.packets / s.runs << ',' << s.lost / s.runs << ','
+         << s.dropped / s.runs << ',' << s.bytes / s.runs << ','
+         << s.events / s.runs << ',' << s.mismatches << endl;
+}
+
+void printJson(Result const& r, int threads, bool first) {
+    cout << (first ? "[\n" : ",\n") << "  {\"protocol\": \"" << r.run.protocol
+         << "\", \"scenario\": \"" << r.run.scenario
+         << "\", \"nodes\": " << r.run.nodes
+         << ", \"degree\": " << r.run.degree
+         << ", \"poisonreverse\": " << boolalpha << r.run.poisonReverse
+         << ", \"horizon\": \"" << r.run.horizon
+         << "\", \"infinity\": " << r.run.infinity
+         << ", \"path_vector\": " << r.run.pathVector
+         << ", \"update_delay\": " << r.run.updateDelay
+         << ", \"holddown\": " << r.run.holddown
+         << ", \"min_interval\": " << r.run.minInterval
+         << ", \"latency\": " << r.run.latency
+         << ", \"bandwidth\": " << r.run.bandwidth
+         << ", \"queue\": " << r.run.queueLimit
+         << ", \"loss\": " << r.run.loss
+         << ", \"refresh\": " << r.run.refresh
+         << ", \"order\": \"" << r.run.order
+         << "\", \"links\": " << r.links
+         << ", \"cut_links\": " << r.cutLinks << ", \"seed\": " << r.run.seed
+         << ", \"threads\": " << threads << ", \"wall_ms\": " << r.wallMs
+         << ", \"convergence_time\": " << r.stats.convergenceTime
+         << ", \"end_time\": " << r.endTime
+         << ", \"packets\": " << r.stats.packetsSent
+         << ", \"lost\": " << r.stats.packetsLost
+         << ", \"dropped\": " << r.stats.packetsDropped
+         << ", \"entries\": " << r.stats.entriesSent
+         << ", \"bytes\": " << r.stats.bytesSent
+         << ", \"events\": " << r.stats.eventsProcessed
+         << ", \"events_per_sec\": "
+         << r.stats.eventsProcessed / (r.wallMs / 1000.0)
+         << ", \"mismatches\": " << r.mismatches << "}";
+}
+
+void printJson(Summary const& s, int threads, bool first) {
+    cout << (first ? "[\n" : ",\n") << "  {\"protocol\": \"" << s.run.protocol
+         << "\", \"scenario\": \"" << s.run.scenario
+         << "\", \"nodes\": " << s.run.nodes
+         << ", \"degree\": " << s.run.degree
+         << ", \"poisonreverse\": " << boolalpha << s.run.poisonReverse
+         << ", \"horizon\": \"" << s.run.horizon
+         << "\", \"infinity\": " << s.run.infinity
+         << ", \"path_vector\": " << s.run.pathVector
+         << ", \"update_delay\": " << s.run.updateDelay
+         << ", \"holddown\": " << s.run.holddown
+         << ", \"min_interval\": " << s.run.minInterval
+         << ", \"latency\": " << s.run.latency
+         << ", \"bandwidth\": " << s.run.bandwidth
+         << ", \"queue\": " << s.run.queueLimit
+         << ", \"loss\": " << s.run.loss
+         << ", \"refresh\": " << s.run.refresh
+         << ", \"order\": \"" << s.run.order
+         << "\", \"threads\": " << threads << ", \"runs\": " << s.runs
+         << ", \"wall_ms\": " << s.wallMs / s.runs
+         << ", \"convergence_time\": " << s.convergenceTime / s.runs
+         << ", \"min_convergence_time\": " << s.minConvergenceTime
+         << ", \"max_convergence_time\": " << s.maxConvergenceTime
+         << ", \"packets\": " << s.packets / s.runs
+         << ", \"lost\": " << s.lost / s.runs
+         << ", \"dropped\": " << s.dropped / s.runs
+         << ", \"bytes\": " << s.bytes / s.runs
+         << ", \"events\": " << s.events / s.runs
+         << ", \"mismatches\": " << s.mismatches << "}";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    string inputInfo = " -n, --min-nodes <int> "
+                       "-N, --max-nodes <int> "
+                       "-c, --scenarios <list> "
+                       "-d, --degree <list> "
+                       "-r, --runs <int> "
+                       "-s, --first-seed <long> "
+                       "-p, --poisonreverse <list> "
+                       "-P, --protocol <list> "
+                       "-z, --horizon <list> "
+                       "-i, --infinity <list> "
+                       "-V, --path-vector <list> "
+                       "-D, --update-delay <list> "
+                       "-H, --holddown <double> "
+                       "-m, --min-interval <double> "
+                       "-l, --latency <double> "
+                       "-b, --bandwidth <double> "
+                       "-q, --queue <int> "
+                       "-x, --loss <list> "
+                       "-o, --order <list> "
+                       "-e, --refresh <double> "
+                       "-j, --threads <int> "
+                       "-J, --jobs <int> "
+                       "-S, --summary "
+                       "-f, --format <csv|json>\n";
+
+    option longOptions[] = {
+        { "min-nodes", required_argument, nullptr, 'n' },
+        { "max-nodes", required_argument, nullptr, 'N' },
+        { "scenarios", required_argument, nullptr, 'c' },
+        { "degree", required_argument, nullptr, 'd' },
+        { "runs", required_argument, nullptr, 'r' },
+        { "first-seed", required_argument, nullptr, 's' },
+        { "poisonreverse", required_argument, nullptr, 'p' },
+        { "protocol", required_argument, nullptr, 'P' },
+        { "horizon", required_argument, nullptr, 'z' },
+        { "infinity", required_argument, nullptr, 'i' },
+        { "path-vector", required_argument, nullptr, 'V' },
+        { "update-delay", required_argument, nullptr, 'D' },
+        { "holddown", required_argument, nullptr, 'H' },
+        { "min-interval", required_argument, nullptr, 'm' },
+        { "latency", required_argument, nullptr, 'l' },
+        { "bandwidth", required_argument, nullptr, 'b' },
+        { "queue", required_argument, nullptr, 'q' },
+        { "loss", required_argument, nullptr, 'x' },
+        { "order", required_argument, nullptr, 'o' },
+        { "refresh", required_argument, nullptr, 'e' },
+        { "threads", required_argument, nullptr, 'j' },
+        { "jobs", required_argument, nullptr, 'J' },
+        { "summary", no_argument, nullptr, 'S' },
+        { "format", required_argument, nullptr, 'f' },
+        { nullptr, 0, nullptr, 0 }
+    };
+
+    int minNodes = 8;
+    int maxNodes = 256;
+    vector<string> scenarios = { "static", "change", "fail" };
+    vector<int> degrees = { 4 };
+    int runs = 3;
+    long firstSeed = 1;
+    vector<bool> poisonReverse = { false };
+    vector<string> protocols = { "dv" };
+    vector<string> horizons = { "lab" };
+    vector<int> infinities = { INFINITY_COST };
+    vector<bool> pathVectors = { false };
+    vector<double> updateDelays = { 0.0 };
+    double holddown = 0.0;
+    double minInterval = 0.0;
+    double latency = 0.0;
+    double bandwidth = 0.0;
+    int queueLimit = 0;
+    vector<double> losses = { 0.0 };
+    vector<string> orders = { "none" };
+    double refresh = 0.0;
+    int threads = 1;
+    int jobs = 1;
+    bool summary = false;
+    string format = "csv";
+    int opt;
+    try {
+        while ((opt = getopt_long(argc,
+                                  argv,
+                                  "n:N:c:d:r:s:p:P:z:i:V:D:H:m:"
+                                  "l:b:q:x:o:e:j:J:Sf:",
+                                  longOptions,
+                                  nullptr)) != -1) {
+            switch (opt) {
+            case 'n': {
+                minNodes = stoi(optarg);
+            } break;
+            case 'N': {
+                maxNodes = stoi(optarg);
+            } break;
+            case 'c': {
+                scenarios = splitList(optarg);
+            } break;
+            case 'd': {
+                degrees.clear();
+                for (string const& degree : splitList(optarg)) {
+                    degrees.push_back(stoi(degree));
+                }
+            } break;
+            case 'r': {
+                runs = stoi(optarg);
+            } break;
+            case 's': {
+                firstSeed = stol(optarg);
+            } break;
+            case 'p': {
+                poisonReverse.clear();
+                for (string const& poison : splitList(optarg)) {
+                    poisonReverse.push_back(poison == "true");
+                }
+            } break;
+            case 'P': {
+                protocols = splitList(optarg);
+            } break;
+            case 'z': {
+                horizons = splitList(optarg);
+            } break;
+            case 'i': {
+                infinities.clear();
+                for (string const& infinity : splitList(optarg)) {
+                    infinities.push_back(stoi(infinity));
+                }
+            } break;
+            case 'V': {
+                pathVectors.clear();
+                for (string const& pathVector : splitList(optarg)) {
+                    pathVectors.push_back(pathVector == "true");
+                }
+            } break;
+            case 'D': {
+                updateDelays.clear();
+                for (string const& delay : splitList(optarg)) {
+                    updateDelays.push_back(stod(delay));
+                }
+            } break;
+            case 'H': {
+                holddown = stod(optarg);
+            } break;
+            case 'm': {
+                minInterval = stod(optarg);
+            } break;
+            case 'l': {
+                latency = stod(optarg);
+            } break;
+            case 'b': {
+                bandwidth = stod(optarg);
+            } break;
+            case 'q': {
+                queueLimit = stoi(optarg);
+            } break;
+            case 'x': {
+                losses.clear();
+                for (string const& loss : splitList(optarg)) {
+                    losses.push_back(stod(loss));
+                }
+            } break;
+            case 'o': {
+                orders = splitList(optarg);
+            } break;
+            case 'e': {
+                refresh = stod(optarg);
+            } break;
+            case 'j': {
+                threads = stoi(optarg);
+            } break;
+            case 'J': {
+                jobs = max(1, stoi(optarg));
+            } break;
+            case 'S': {
+                summary = true;
+            } break;
+            case 'f': {
+                format = optarg;
+            } break;
+            default: {
+                cerr << argv[0] << inputInfo;
+                exit(EXIT_FAILURE);
+            } break;
+            }
+        }
+    } catch (invalid_argument&) {
+        cerr << argv[0] << inputInfo << endl;
+        exit(2);
+    }
+
+    // The distance vector settings to compare, as one level of the grid
+    struct Convergence {
+        string horizon;
+        int infinity;
+        bool pathVector;
+    };
+    vector<Convergence> convergences;
+    for (string const& horizon : horizons) {
+        for (int infinity : infinities) {
+            for (bool pathVector : pathVectors) {
+                convergences.push_back({ horizon, infinity, pathVector });
+            }
+        }
+    }
+
+    // The runs of one configuration are consecutive, see --summary
+    vector<Run> grid;
+    for (int nodes = max(2, minNodes); nodes <= maxNodes; nodes *= 2) {
+        for (string const& scenario : scenarios) {
+            for (int degree : degrees) {
+                for (string const& protocol : protocols) {
+                    for (bool poison : poisonReverse) {
+                        for (Convergence const& dv : convergences) {
+                            for (double delay : updateDelays) {
+                                for (double loss : losses) {
+                                    for (string const& order : orders) {
+                                        for (long seed = firstSeed;
+                                             seed < firstSeed + runs;
+                                             seed++) {
+                                            grid.push_back({ protocol,
+                                                             scenario,
+                                                             nodes,
+                                                             degree,
+                                                             poison,
+                                                             dv.horizon,
+                                                             dv.infinity,
+                                                             dv.pathVector,
+                                                             delay,
+                                                             holddown,
+                                                             minInterval,
+                                                             latency,
+                                                             bandwidth,
+                                                             queueLimit,
+                                                             loss,
+                                                             refresh,
+                                                             order,
+                                                             seed });
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    vector<Result> results(grid.size());
+    vector<bool> done(grid.size(), false);
+    size_t next = 0;
+    mutex resultMutex;
+    condition_variable resultDone;
+    vector<thread> workers;
+    for (int i = 0; i < min<int>(jobs, grid.size()); i++) {
+        workers.emplace_back([&] {
+            while (true) {
+                size_t index;
+                {
+                    lock_guard<mutex> lock{ resultMutex };
+                    if (next == grid.size()) {
+                        return;
+                    }
+                    index = next++;
+                }
+                Result result = runOnce(grid[index], threads);
+                {
+                    lock_guard<mutex> lock{ resultMutex };
+                    results[index] = std::move(result);
+                    done[index] = true;
+                }
+                resultDone.notify_all();
+            }
+        });
+    }
+
+    bool json = format == "json";
+    if (!json) {
+        printCsvHeader(summary);
+    }
+    long failures = 0;
+    long expectedFailures = 0;
+    bool first = true;
+    Summary group;
+    for (size_t index = 0; index < grid.size(); index++) {
+        {
+            unique_lock<mutex> lock{ resultMutex };
+            resultDone.wait(lock, [&] { return done[index]; });
+        }
+        Result const& result = results[index];
+        if (staleRoutesExpected(result.run)) {
+            expectedFailures += result.mismatches != 0;
+        } else {
+            failures += result.mismatches != 0;
+        }
+        if (summary) {
+            addToSummary(group, result);
+            if (group.runs < runs) {
+                continue;
+            }
+            if (json) {
+                printJson(group, threads, first);
+            } else {
+                printCsv(group, threads);
+            }
+            group = Summary{};
+        } else if (json) {
+            printJson(result, threads, first);
+        } else {
+            printCsv(result, threads);
+        }
+        first = false;
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    if (json) {
+        cout << (first ? "[" : "") << "\n]" << endl;
+    }
+    if (expectedFailures != 0) {
+        cerr << expectedFailures << " runs with the lab's poisoned reverse "
+             << "and link changes disagree with Dijkstra, as expected" << endl;
+    }
+    if (failures != 0) {
+        cerr << failures << " runs disagree with Dijkstra" << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
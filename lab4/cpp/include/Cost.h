@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+/*
+ * The type of the costs in the tables of RouterNode. The distance matrix
+ * holds one cost per neighbor and destination, so 16 bit costs halve the
+ * memory of a node and let the SIMD relaxation handle twice the destinations
+ * per instruction. They limit INFINITY to 65535; build with COST_BITS=32 for
+ * larger costs.
+ */
+#if COST_BITS == 32
+using Cost = int;
+#else
+using Cost = std::uint16_t;
+#endif
+
+// The largest INFINITY a Cost can hold. Costs are added as int, so it also
+// stays below INT_MAX / 2.
+const int MAX_INFINITY =
+    std::numeric_limits<Cost>::max() < (1 << 29)
+        ? static_cast<int>(std::numeric_limits<Cost>::max())
+        : (1 << 29);
@@ -1,23 +1,45 @@
 #pragma once
 
+#ifndef HEADLESS
 #include <QMainWindow>
 #include <QPlainTextEdit>
+#include <QTimer>
+#include <mutex>
+#endif
+#include <cstddef>
 #include <string>
 
+// Built with -DHEADLESS, windows are never created and all output is dropped,
+// which lets the benchmarks run without Qt.
+//
+// Otherwise text printed from any thread is only queued, and the Qt event
+// loop appends what was queued to the window in batches from a timer, so
+// printing never waits for the widget. Windows keep their last lines only,
+// see setMaxLines.
 class GuiTextArea {
 public:
     GuiTextArea(const GuiTextArea&) = delete;
-    // RouterNode requires its GuiTextArea instance to have a move constructor
-    GuiTextArea(GuiTextArea&&) = default;
+    GuiTextArea(GuiTextArea&&) = delete;
     GuiTextArea& operator=(const GuiTextArea&) = delete;
     GuiTextArea& operator=(GuiTextArea&&) = delete;
 
     GuiTextArea(std::string const&);
+    ~GuiTextArea();
+    static void setMaxLines(int);
     void print(std::string const&);
     void println(std::string const&);
     void println();
 
+#ifndef HEADLESS
 private:
+    void render();
+
+    static int maxLines;
     QMainWindow* myGUI;
     QPlainTextEdit* textedit;
+    QTimer* timer;
+    std::mutex queueMutex;
+    std::string queued; /* printed but not rendered yet */
+    std::size_t queuedLines{ 0 }; /* newlines in queued */
+#endif
 };
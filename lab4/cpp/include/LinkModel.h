@@ -0,0 +1,64 @@
+#pragma once
+
+#include "LinkRandom.h"
+#include "Snapshot.h"
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+// How a directed link carries packets, see LinkModel
+struct LinkProperties {
+    double latency;   /* propagation delay, must be positive */
+    double bandwidth; /* bytes per time unit, 0 to send instantly */
+    int queueLimit;   /* packets queued or being sent, 0 for no limit */
+    double loss;      /* probability that a sent packet is lost */
+};
+
+/*
+ * Medium with latency, bandwidth, a bounded FIFO queue and random loss on
+ * every directed link, used instead of the lab's random delays when
+ * RouterSimulator is given a latency (--latency).
+ *
+ * A packet waits in the queue of its link until the packets ahead of it were
+ * sent, takes its size divided by the bandwidth to send and arrives `latency`
+ * after that. Links never reorder packets: one that would arrive together
+ * with the previous packet of its link arrives just after it instead, since
+ * events at the same time are simulated newest first. A packet that finds
+ * `queueLimit` packets queued or being sent is dropped at the tail, and a
+ * sent packet is lost with probability `loss`.
+ *
+ * Links get the default properties unless a link file gives them their own,
+ * one link per line for both of its directions:
+ *   <from> <to> <latency> <bandwidth> <queue> <loss>
+ * Empty lines and lines starting with # are skipped.
+ */
+class LinkModel {
+public:
+    // What became of a packet handed to the medium
+    enum Outcome { DELIVERED, DROPPED, LOST };
+
+    LinkModel(LinkProperties const&, int);
+    explicit LinkModel(SnapshotReader&);
+
+    void load(std::string const&);
+    double minLatency() const;
+    Outcome transmit(int, int, std::size_t, double, LinkRandom&, double&);
+    void save(SnapshotWriter&) const;
+
+private:
+    struct Link {
+        int to;
+        LinkProperties properties;
+        std::deque<double> queue; /* when the queued packets are sent */
+        double lastArrival;       /* of the latest packet sent */
+    };
+
+    static void checkProperties(LinkProperties const&, std::string const&);
+    Link& link(int, int);
+
+    LinkProperties defaults;
+    // Links with properties or packets, per source sorted by destination
+    std::vector<std::vector<Link>> links;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Counter-based random stream of one directed link.
+ *
+ * The n-th number is the SplitMix64 finalizer applied to key + n * gamma,
+ * where the key mixes the simulation seed with the link's endpoints. So the
+ * stream only depends on the seed and the link, never on what other links
+ * drew before, and its whole state is the number of values drawn so far.
+ */
+class LinkRandom {
+public:
+    LinkRandom(long seed, int from, int to);
+
+    double nextDouble();
+    std::uint64_t drawn() const;
+    void setDrawn(std::uint64_t);
+
+private:
+    std::uint64_t key;
+    std::uint64_t counter{ 0 };
+};
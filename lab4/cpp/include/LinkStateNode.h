@@ -0,0 +1,62 @@
+#pragma once
+
+#include "GuiTextArea.h"
+#include "Router.h"
+#include "RouterPacket.h"
+#include "RouterSimulator.h"
+#include "Snapshot.h"
+
+#include <utility>
+#include <vector>
+
+class RouterSimulator;
+
+/*
+ * Link-state routing: every router floods an advertisement of its own links
+ * whenever one of them changes, and every REFRESH if set, keeps the newest
+ * advertisement of every router in its link-state database, and computes its
+ * routes with Dijkstra over that database.
+ */
+class LinkStateNode : public Router {
+public:
+    LinkStateNode(int,
+                  RouterSimulator*,
+                  std::vector<std::pair<int, int>> const&);
+    LinkStateNode(int, RouterSimulator*, SnapshotReader&);
+    void save(SnapshotWriter&) const override;
+    void recvUpdate(RouterPacket&) override;
+    void printDistanceTable() override;
+    void updateLinkCost(int, int) override;
+    void timerExpired(int) override;
+    int getDistance(int) const override;
+    int getFirstHop(int) const override;
+    double getLastChange() const override;
+
+private:
+    int linkCost(int, int) const;
+    void install(int, int, std::vector<std::pair<int, int>>);
+    void flood(int, int);
+    void sendDatabase(int);
+    void runSpf();
+
+    GuiTextArea myGUI;
+    RouterSimulator* sim;
+    int myID;
+
+    std::vector<std::pair<int, int>> links; /* our (neighbor, cost) links */
+    int mySequence{ 0 };
+    // Link-state database: the newest advertisement of every router, with
+    // sequence 0 for routers we have not heard from yet.
+    std::vector<int> sequences;
+    std::vector<std::vector<std::pair<int, int>>> lsas;
+
+    // Shortest path tree from the last SPF run
+    std::vector<int> myDistances;
+    std::vector<int> parents;   /* previous node on the path, -1 if none */
+    std::vector<int> firstHops; /* next hop per destination, -1 if none */
+    double lastChange{ 0.0 };   /* time our distances last changed */
+    long spfRuns{ 0 };          /* full SPF runs, the rest were skipped */
+
+    // Timer set with RouterSimulator::setTimer every REFRESH
+    const int REFRESH_TIMER = 0;
+};
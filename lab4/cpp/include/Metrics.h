@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * Runtime metrics of a simulation, see RouterSimulator::initialize
+ * (--metrics).
+ *
+ * Counts packets per node and per directed link, samples the number of
+ * pending events into a histogram and measures the wall time spent in the
+ * routers (recvUpdate, updateLinkCost and timers) and in the event list and
+ * medium. Everything is dumped as one line of JSON per dump: every
+ * `interval` wall seconds while the simulation runs, and once at the end
+ * with the per node and per link counters.
+ *
+ * Counters of a node are only touched by the thread simulating it, and
+ * times are kept per thread, so the parallel simulation needs no locks.
+ */
+class SimulatorMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SimulatorMetrics(const SimulatorMetrics&) = delete;
+    SimulatorMetrics(SimulatorMetrics&&) = delete;
+    SimulatorMetrics& operator=(const SimulatorMetrics&) = delete;
+    SimulatorMetrics& operator=(SimulatorMetrics&&) = delete;
+
+    SimulatorMetrics(std::string const&, int, int, double);
+
+    void sent(int, int);
+    void received(int, int);
+    void nodeTime(int, int, Clock::duration);
+    void scheduleTime(int, Clock::duration);
+    Clock::duration measured(int) const;
+    void queueDepth(std::size_t);
+    bool due() const;
+    void dump(double, long, std::size_t, bool);
+
+private:
+    // Packets over the link to or from `node`
+    struct LinkCount {
+        int node;
+        long packets;
+    };
+
+    // Wall time of one simulating thread, on a cache line of its own
+    struct alignas(64) ThreadTime {
+        Clock::duration node{ 0 };
+        Clock::duration schedule{ 0 };
+    };
+
+    static long& linkCount(std::vector<LinkCount>&, int);
+
+    std::string path;
+    std::ofstream file;
+    Clock::duration interval;
+    Clock::time_point start;
+    Clock::time_point nextDump;
+    Clock::time_point lastDump;
+    long lastEvents{ 0 }; /* events at lastDump */
+
+    std::vector<long> nodeSent;
+    std::vector<long> nodeReceived;
+    std::vector<double> nodeSeconds;
+    // Indexed by sender and by receiver, sorted by the other end
+    std::vector<std::vector<LinkCount>> outgoing;
+    std::vector<std::vector<LinkCount>> incoming;
+    std::vector<ThreadTime> threads;
+
+    // Samples with a queue depth of 0, 1, 2-3, 4-7, 8-15, ...
+    std::vector<long> depthHistogram;
+    std::size_t maxDepth{ 0 };
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Min-plus relaxation kernel used by RouterNode::updateDistanceCosts.
+ *
+ * `rows` is a row-major matrix with one row of `width` distances per neighbor
+ * slot, and `linkcosts` holds the link cost to each of the `numRows`
+ * neighbors. For every destination column d in [begin, end) this computes
+ *   best[d]     = min{ linkcosts[s] + rows[s * width + d] }
+ *   bestSlot[d] = the lowest slot s reaching that minimum
+ * where sums saturate at `infinity`. A destination that cannot be reached for
+ * less than `infinity` gets best[d] = infinity and bestSlot[d] = -1.
+ *
+ * All costs must be in [0, infinity] and infinity must be below INT_MAX / 2.
+ * The 16 bit version takes infinity up to 65535 and handles twice as many
+ * destinations per SIMD instruction, for up to 32767 rows.
+ */
+void minPlusRelax(int const* linkcosts,
+                  int const* rows,
+                  std::size_t numRows,
+                  std::size_t width,
+                  std::size_t begin,
+                  std::size_t end,
+                  int infinity,
+                  int* best,
+                  int* bestSlot);
+void minPlusRelax(std::uint16_t const* linkcosts,
+                  std::uint16_t const* rows,
+                  std::size_t numRows,
+                  std::size_t width,
+                  std::size_t begin,
+                  std::size_t end,
+                  int infinity,
+                  std::uint16_t* best,
+                  int* bestSlot);
+
+// Portable version of minPlusRelax, always used when the CPU lacks SSE4.1.
+void minPlusRelaxScalar(int const* linkcosts,
+                        int const* rows,
+                        std::size_t numRows,
+                        std::size_t width,
+                        std::size_t begin,
+                        std::size_t end,
+                        int infinity,
+                        int* best,
+                        int* bestSlot);
+void minPlusRelaxScalar(std::uint16_t const* linkcosts,
+                        std::uint16_t const* rows,
+                        std::size_t numRows,
+                        std::size_t width,
+                        std::size_t begin,
+                        std::size_t end,
+                        int infinity,
+                        std::uint16_t* best,
+                        int* bestSlot);
+
+// Name of the instruction set minPlusRelax dispatches to on this CPU.
+char const* minPlusImplementation();
+
+/*
+ * minPlusRelax over all columns of rows `Width` wide, for widths known at
+ * compile time. Costs are of type `T`, int or std::uint16_t. Slots are kept
+ * in lanes of the same type, and the sums saturate without being widened, so
+ * the loop over columns has a single element type and a constant bound, and
+ * the compiler vectorizes it with the minimums kept in registers.
+ *
+ * That only beats minPlusRelax when a row is exactly one 16 byte vector, 8
+ * Costs of 16 bits or 4 ints: narrower rows leave a scalar tail and wider
+ * ones lose to AVX2 (see MinPlusBench). Other widths go to minPlusRelax.
+ */
+template <std::size_t Width, typename T>
+void minPlusRelaxFixed(T const* linkcosts,
+                       T const* rows,
+                       std::size_t numRows,
+                       int infinity,
+                       T* best,
+                       int* bestSlot) {
+    if constexpr (Width * sizeof(T) != 16) {
+        minPlusRelax(linkcosts,
+                     rows,
+                     numRows,
+                     Width,
+                     0,
+                     Width,
+                     infinity,
+                     best,
+                     bestSlot);
+        return;
+    }
+    T const inf = static_cast<T>(infinity);
+    T const none = static_cast<T>(-1);
+    std::array<T, Width> minCost;
+    std::array<T, Width> minSlot;
+    minCost.fill(inf);
+    minSlot.fill(none);
+    for (std::size_t s = 0; s < numRows; s++) {
+        T linkcost = linkcosts[s];
+        T headroom = static_cast<T>(inf - linkcost);
+        T slot = static_cast<T>(s);
+        T const* row = rows + s * Width;
+        for (std::size_t d = 0; d < Width; d++) {
+            // Selects instead of branches, so the columns are vectorized
+            T sum = row[d] < headroom ? static_cast<T>(linkcost + row[d]) : inf;
+            bool less = sum < minCost[d];
+            minCost[d] = less ? sum : minCost[d];
+            minSlot[d] = less ? slot : minSlot[d];
+        }
+    }
+    for (std::size_t d = 0; d < Width; d++) {
+        best[d] = minCost[d];
+        bestSlot[d] = minSlot[d] == none ? -1 : static_cast<int>(minSlot[d]);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Scenario.h"
+#include "Topology.h"
+
+#include <memory>
+#include <vector>
+
+// How Renumbering orders the nodes of a topology
+enum class NodeOrder {
+    None, /* keep the IDs of the topology */
+    BFS,  /* breadth first from the lowest ID of every component */
+    RCM,  /* reverse Cuthill-McKee */
+};
+
+/*
+ * New IDs for the nodes of a topology, so that nodes that are linked get IDs
+ * close to each other. The simulator and the nodes keep their tables in
+ * vectors indexed by ID, so the data of neighbors is then close in memory,
+ * and Topology::partition splits the nodes into partitions with few links
+ * between them.
+ *
+ * Simulate the renumbered topology and link changes, and map the IDs of the
+ * results back with `original`.
+ */
+class Renumbering {
+public:
+    Renumbering(Topology const&, NodeOrder);
+
+    int renumbered(int) const;
+    int original(int) const;
+    Topology renumbered(Topology const&) const;
+    Topology original(Topology const&) const;
+    std::vector<LinkChange> renumbered(std::vector<LinkChange> const&) const;
+    std::unique_ptr<LinkChangeSource>
+    renumbered(std::unique_ptr<LinkChangeSource>) const;
+
+private:
+    std::vector<int> newIDs;      /* new ID of every original ID */
+    std::vector<int> originalIDs; /* original ID of every new ID */
+};
+
+/*
+ * The changes of another source, with the new IDs of a Renumbering
+ */
+class RenumberedSource : public LinkChangeSource {
+public:
+    RenumberedSource(std::unique_ptr<LinkChangeSource>, Renumbering);
+    bool next(LinkChange&) override;
+
+private:
+    std::unique_ptr<LinkChangeSource> source;
+    Renumbering renumbering;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "RouterPacket.h"
+#include "Snapshot.h"
+
+// The routing protocols a simulation can run, see SimulatorConfig
+enum class Protocol { DistanceVector, LinkState };
+
+// What distance vector routers advertise back to the neighbor a route goes
+// through: only the poison of the lab (`POISONREVERSE`, for the link that
+// changed), nothing (split horizon) or INFINITY (poisoned reverse)
+enum class Horizon { Lab, Split, Poison };
+
+/*
+ * The routing protocol engine of one node. RouterSimulator hands it the
+ * packets it receives, the cost changes of its links and the timers it set
+ * with RouterSimulator::setTimer, and the engine sends packets of its own
+ * with RouterSimulator::toLayer2.
+ */
+class Router {
+public:
+    Router(const Router&) = delete;
+    Router(Router&&) = delete;
+    Router& operator=(const Router&) = delete;
+    Router& operator=(Router&&) = delete;
+    virtual ~Router() = default;
+
+    virtual void recvUpdate(RouterPacket&) = 0;
+    virtual void updateLinkCost(int, int) = 0;
+    virtual void timerExpired(int) = 0;
+    virtual void printDistanceTable() = 0;
+    virtual int getDistance(int) const = 0;
+    virtual int getFirstHop(int) const = 0;
+    virtual double getLastChange() const = 0;
+    virtual void save(SnapshotWriter&) const = 0;
+
+protected:
+    Router() = default;
+};
@@ -1,38 +1,141 @@
 #pragma once
 
+#include "Cost.h"
 #include "GuiTextArea.h"
+#include "Router.h"
 #include "RouterPacket.h"
 #include "RouterSimulator.h"
+#include "Snapshot.h"
 
-#include <string>
+#include <array>
+#include <memory>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 class RouterSimulator;
 
-class RouterNode {
-public:
-    RouterNode(const RouterNode&) = delete;
-    // std::vector<RouterNode> in RouterSimulator.h requires move constructor
-    RouterNode(RouterNode&&) = default;
-    RouterNode& operator=(const RouterNode&) = delete;
-    RouterNode& operator=(RouterNode&&) = delete;
+// Networks of up to this many nodes get a RouterNode with fixed size tables
+const int MAX_FIXED_NODES = 8;
 
-    RouterNode(int, RouterSimulator*, std::vector<int> const&);
-    void recvUpdate(RouterPacket&);
-    void printDistanceTable();
-    void updateLinkCost(int, int);
+/*
+ * The distance vector protocol of the lab.
+ *
+ * `FixedNodes` is the number of nodes in the network when it is known at
+ * compile time, or 0 to take it from the simulator. With a fixed count every
+ * table with an entry per destination is a std::array inside the node, and
+ * loops over destinations have constant bounds the compiler can unroll, which
+ * saves small networks the allocations and indirections of std::vector.
+ * makeRouterNode picks the variant for the size of the network.
+ */
+template <int FixedNodes = 0>
+class RouterNode : public Router {
+public:
+    RouterNode(int,
+               RouterSimulator*,
+               std::vector<std::pair<int, int>> const&);
+    RouterNode(int, RouterSimulator*, SnapshotReader&);
+    void save(SnapshotWriter&) const override;
+    void recvUpdate(RouterPacket&) override;
+    void printDistanceTable() override;
+    void updateLinkCost(int, int) override;
+    void timerExpired(int) override;
+    int getDistance(int) const override;
+    int getFirstHop(int) const override;
+    double getLastChange() const override;
 
 private:
-    void sendUpdate(RouterPacket&);
+    // A table with one entry per destination
+    template <typename T>
+    using PerNode = std::conditional_t<FixedNodes == 0,
+                                       std::vector<T>,
+                                       std::array<T, FixedNodes>>;
+
+    void sendUpdate(RouterPacket&&);
 
     GuiTextArea myGUI;
     RouterSimulator* sim;
     int myID;
-    std::vector<int> costs;
 
     // Variables + methods not in the original lab template:
-    void updateDistanceCosts();
-    void notifyNetwork(int* = nullptr);
-    std::vector<std::vector<int>> distances;
-    std::vector<std::string> routes;
+    // Only real neighbors get a slot, so every per-neighbor vector below has
+    // one entry per adjacent node instead of one per node in the network.
+    int numNodes() const;
+    template <typename T> PerNode<T> makePerNode(T const&) const;
+    template <typename T> PerNode<T> restorePerNode(SnapshotReader&) const;
+    int neighborSlot(int) const;
+    Cost toCost(int) const;
+    int addNeighbor(int, int);
+    std::vector<int> updateDistanceCosts(std::vector<int> const&);
+    void relaxAll();
+    int advertisedCost(int, int) const;
+    std::vector<int> const& advertisedPath(int, int) const;
+    RouterPacket fullUpdate(int, std::vector<Cost> const&) const;
+    void notifyNetwork(std::vector<int> const&, int* = nullptr);
+    void triggerUpdate(std::vector<int> const&, int* = nullptr);
+    void sendPending();
+    bool holding(int, double) const;
+    std::vector<int> neighbors;              /* sorted neighbor IDs */
+    std::vector<Cost> costs;     /* link cost per neighbor slot */
+    std::vector<Cost> distances; /* one row of NUM_NODES per neighbor slot */
+    PerNode<Cost> myDistances;
+    PerNode<int> firstHops;   /* next hop per destination, -1 if none */
+    double lastChange{ 0.0 }; /* time our distance vector last changed */
+    std::vector<std::vector<Cost>> advertised; /* last vector sent per slot */
+    std::vector<int> poisoned; /* destinations poisoned in the last update */
+    PerNode<Cost> bestCosts; /* scratch space for updateDistanceCosts */
+    PerNode<int> bestSlots;
+
+    // With PATHVECTOR every route has its path, so that nodes can tell
+    // routes that lead back through themselves, see recvUpdate.
+    PerNode<std::vector<int>> myPaths;      /* [myID, ..., dest] or empty */
+    std::vector<std::vector<int>> neighborPaths; /* NUM_NODES per slot */
+
+    // Triggered updates wait for SEND_TIMER when UPDATEDELAY or MININTERVAL
+    // is set, and are merged into one update, see triggerUpdate.
+    std::vector<int> pending;  /* destinations that changed since */
+    PerNode<bool> isPending;   /* per destination, whether in `pending` */
+    int pendingPoison{ -1 };   /* link to poison in the update, or -1 */
+    bool sendTimerSet{ false };
+    PerNode<double> holdUntil; /* end of the HOLDDOWN per destination */
+    PerNode<Cost> holdCosts;   /* cost of the lost route, when held */
+    std::vector<int> held;     /* destinations in hold-down */
+
+    // Timers set with RouterSimulator::setTimer
+    const int SEND_TIMER = 0;
+    const int HOLDDOWN_TIMER = 1;
+    const int REFRESH_TIMER = 2; /* resend everything every REFRESH */
 };
+
+// Defined for 0 and 3 to MAX_FIXED_NODES in RouterNode.cpp
+extern template class RouterNode<0>;
+extern template class RouterNode<3>;
+extern template class RouterNode<4>;
+extern template class RouterNode<5>;
+extern template class RouterNode<6>;
+extern template class RouterNode<7>;
+extern template class RouterNode<8>;
+
+/*
+ * A RouterNode for a network of `numNodes` nodes, with fixed size tables up
+ * to MAX_FIXED_NODES nodes. The other arguments go to its constructor.
+ */
+template <typename... Args>
+std::unique_ptr<Router> makeRouterNode(int numNodes, Args&&... args) {
+    switch (numNodes) {
+    case 3:
+        return std::make_unique<RouterNode<3>>(std::forward<Args>(args)...);
+    case 4:
+        return std::make_unique<RouterNode<4>>(std::forward<Args>(args)...);
+    case 5:
+        return std::make_unique<RouterNode<5>>(std::forward<Args>(args)...);
+    case 6:
+        return std::make_unique<RouterNode<6>>(std::forward<Args>(args)...);
+    case 7:
+        return std::make_unique<RouterNode<7>>(std::forward<Args>(args)...);
+    case 8:
+        return std::make_unique<RouterNode<8>>(std::forward<Args>(args)...);
+    default:
+        return std::make_unique<RouterNode<0>>(std::forward<Args>(args)...);
+    }
+}
@@ -1,18 +1,39 @@
 #pragma once
 
+#include <cstddef>
+#include <utility>
 #include <vector>
 
 class RouterPacket {
 public:
     RouterPacket(const RouterPacket&) = delete;
-    RouterPacket(RouterPacket&&) = delete;
+    // RouterSimulator::toLayer2 moves packets into the medium
+    RouterPacket(RouterPacket&&) = default;
     RouterPacket& operator=(const RouterPacket&) = delete;
     RouterPacket& operator=(RouterPacket&&) = delete;
 
     RouterPacket(int, int, std::vector<int>);
-    RouterPacket* clone() const;
+    RouterPacket(int, int, std::vector<std::pair<int, int>>);
+    RouterPacket(int, int, int, int, std::vector<std::pair<int, int>>);
+    bool isFull() const;
+    bool isComplete() const;
+    bool isLinkState() const;
+    std::size_t numEntries() const;
+    std::size_t size() const;
 
     int sourceid;
     int destid;
+    // A packet either carries the full distance vector (on resync), or only
+    // the (destination, cost) entries that changed since the last packet.
     std::vector<int> mincost;
+    std::vector<std::pair<int, int>> changes;
+    // With split horizon a full vector is sent as `changes` without the
+    // entries the receiver routes us through, which are then unreachable.
+    bool complete{ false };
+    // With PATHVECTOR, the path [sender, ..., destination] of every entry.
+    std::vector<std::vector<int>> paths;
+    // A link-state advertisement instead carries the (neighbor, cost) links
+    // of the router `origin` in `changes`, numbered by `sequence`.
+    int origin{ -1 };
+    int sequence{ 0 };
 };
@@ -1,9 +1,23 @@
 #pragma once
 
 #include "GuiTextArea.h"
-#include "RouterNode.h"
+#include "LinkModel.h"
+#include "LinkRandom.h"
+#include "Metrics.h"
+#include "Router.h"
 #include "RouterPacket.h"
+#include "Scenario.h"
+#include "Snapshot.h"
+#include "Topology.h"
+#include "Trace.h"
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 struct Event {
@@ -12,17 +26,65 @@ struct Event {
     Event& operator=(const Event&) = delete;
     Event& operator=(Event&&) = delete;
 
-    double evtime;          /* event time */
-    int evtype;             /* event type code */
-    int eventity;           /* entity where event occurs */
-    RouterPacket* rtpktptr; /* ptr to packet (if any)  */
-    int dest;               /* destination */
-    int cost;               /* for link cost change */
-    Event* prev{ nullptr };
-    Event* next{ nullptr };
+    double evtime;              /* event time */
+    int evtype;                 /* event type code */
+    int eventity;               /* entity where event occurs */
+    RouterPacket* rtpktptr;     /* ptr to packet (if any)  */
+    int dest;                   /* destination, or the timer that expired */
+    int cost;                   /* for link cost change */
+    long seq;                   /* insertion order, set by insertevent */
+    std::uint64_t tracepayload; /* packet contents in the trace, 0 if none */
 };
 
-class RouterNode;
+// Configuration of one simulation, see RouterSimulator::initialize
+struct SimulatorConfig {
+    int NUM_NODES{ 3 };
+    bool LINKCHANGES{ true };
+    bool POISONREVERSE{ true };
+    long SEED{ 1234 };
+    int TRACE{ 3 };
+    int THREADS{ 1 };
+    Protocol PROTOCOL{ Protocol::DistanceVector };
+    double UNTIL{ std::numeric_limits<double>::max() };
+    std::string SAVEFILE;    /* snapshot to save when the run ends */
+    std::string RESTOREFILE; /* snapshot to start from */
+    std::string SCENARIOFILE; /* link changes to stream in */
+    double CHURNRATE{ 0.0 };  /* random link changes per time unit */
+    double CHURNUNTIL{ 10000.0 };
+    std::string TRACEFILE; /* binary trace to write */
+    bool REPORTCHANGES{ false };  /* TRACE > 2 only prints changed routes */
+    double REPORTINTERVAL{ 0.0 }; /* TRACE > 2 prints all tables this often */
+    // Distance vector update timers, 0 to disable, see RouterNode
+    double UPDATEDELAY{ 0.0 }; /* wait this long to merge triggered updates */
+    double HOLDDOWN{ 0.0 };    /* ignore new routes this long after a loss */
+    double MININTERVAL{ 0.0 }; /* least time between two updates of a node */
+    int GUILINES{ 10000 };     /* lines kept by every window */
+    std::string METRICSFILE;      /* runtime metrics to write */
+    double METRICSINTERVAL{ 0.0 }; /* wall seconds between metrics dumps */
+    // Link model, used instead of the random delays when LATENCY is set
+    double LATENCY{ 0.0 };   /* default propagation delay, 0 for random */
+    double BANDWIDTH{ 0.0 }; /* default bytes per time unit, 0 for no limit */
+    int QUEUELIMIT{ 0 };     /* default queue length per link, 0 for none */
+    double LOSS{ 0.0 };      /* default probability that a packet is lost */
+    std::string LINKFILE;    /* properties of single links */
+    double REFRESH{ 0.0 };   /* routers resend everything this often */
+    double REFRESHUNTIL{ 10000.0 };
+    // Distance vector convergence, see RouterNode::notifyNetwork
+    Horizon HORIZON{ Horizon::Lab }; /* what is advertised to next hops */
+    int INFINITY{ 999 };      /* least cost of an unreachable route */
+    bool PATHVECTOR{ false }; /* send paths and ignore routes through us */
+};
+
+// Counters collected over a simulation run
+struct SimulationStats {
+    long packetsSent{ 0 };
+    long entriesSent{ 0 };
+    long bytesSent{ 0 };
+    long eventsProcessed{ 0 };
+    double convergenceTime{ 0.0 }; /* last change of any distance vector */
+    long packetsLost{ 0 };         /* lost on a link by the LinkModel */
+    long packetsDropped{ 0 };      /* dropped at a full link queue */
+};
 
 class RouterSimulator {
 public:
@@ -31,32 +93,147 @@ public:
     RouterSimulator& operator=(const RouterSimulator&) = delete;
     RouterSimulator& operator=(RouterSimulator&&) = delete;
 
-    RouterSimulator();
+    explicit RouterSimulator(SimulatorConfig const&);
+    RouterSimulator(SimulatorConfig const&,
+                    Topology,
+                    std::vector<LinkChange> const&);
+    RouterSimulator(SimulatorConfig const&, SnapshotReader&);
 
     static void main(int, char*[]);
-    static void initialize(int, char*[]);
-    void runSimulation();
+    static SimulatorConfig initialize(int, char*[]);
+    void runSimulation(double = std::numeric_limits<double>::max());
+    void stop();
+    void addLinkChanges(std::vector<LinkChange> const&);
+    void streamLinkChanges(std::unique_ptr<LinkChangeSource>);
+    void saveSnapshot(std::string const&) const;
     double getClockTime();
     void insertevent(Event*);
-    void toLayer2(RouterPacket&);
+    void toLayer2(RouterPacket&&);
+    void setTimer(int, double, int);
+    SimulationStats const& getStats() const;
+    Router const& getNode(int) const;
+    Topology const& getTopology() const;
 
-    // Use command line arguments to configure each variable.
-    static int NUM_NODES;      /* defaults to 3 */
-    static bool LINKCHANGES;   /* defaults to true */
-    static bool POISONREVERSE; /* defaults to true */
-    static long SEED;          /* defaults to 1234 */
-    static int TRACE;          /* defaults to 3 */
+    // Set from the SimulatorConfig, so that several simulations with
+    // different settings can run in one process.
+    const int NUM_NODES;
+    const bool LINKCHANGES;
+    const bool POISONREVERSE;
+    const long SEED;
+    const int TRACE;
+    const int THREADS;
+    const Protocol PROTOCOL;
+    const bool REPORTCHANGES;
+    const double REPORTINTERVAL;
+    const double UPDATEDELAY;
+    const double HOLDDOWN;
+    const double MININTERVAL;
+    const double REFRESH;
+    const double REFRESHUNTIL;
+    const Horizon HORIZON;
+    const bool PATHVECTOR;
 
-    const int INFINITY = 999;
+    // Link costs of INFINITY or more are taken as INFINITY, a failed link
+    const int INFINITY;
 
 private:
+    // A routing update sent or a timer set while a parallel window was
+    // running, kept until the end of the window so that it is scheduled in
+    // sequential order.
+    struct PendingSend {
+        double evtime; /* time of the event that sent it */
+        long evseq;    /* seq of the event that sent it */
+        int index;     /* order among the sends of that event */
+        RouterPacket* pkt;
+        Event* timer; /* the timer event instead, if `pkt` is null */
+    };
+
+    // Nodes are split over partitions, each with its own event heap, by
+    // Topology::partition.
+    struct Partition {
+        std::vector<Event*> events;
+        std::vector<PendingSend> outbox;
+        double lasttime{ 0.0 }; /* time of the last event processed */
+        long processed{ 0 };    /* number of events processed */
+        long evseq{ 0 };        /* seq of the event being processed */
+        int sends{ 0 };         /* sends made by the event being processed */
+    };
+
+    // A stream of link changes, with its next change in the event list
+    struct LinkStream {
+        std::unique_ptr<LinkChangeSource> source;
+        Event* pending;
+    };
+
+    // The partition the current thread is simulating a window for, if any
+    static thread_local Partition* activePartition;
+
+    RouterSimulator(SimulatorConfig const&,
+                    std::unique_ptr<LinkModel>,
+                    Topology);
+    static std::vector<LinkChange> builtinLinkChanges(SimulatorConfig const&);
+    static SimulatorConfig snapshotConfig(SimulatorConfig, SnapshotReader&);
+    static bool eventAfter(Event const*, Event const*);
+    static std::unique_ptr<LinkModel> makeLinkModel(SimulatorConfig const&,
+                                                    int);
+    static double lookahead(SimulatorConfig const&, LinkModel const*);
+    LinkRandom& linkStream(int, int);
+    std::unique_ptr<Router> makeRouter(int);
+    int partitionOf(int) const;
+    Event* peekEvent();
+    Event* popEvent();
+    void processEvent(Event*);
+    void pushEvent(Event*);
+    Event* scheduleLinkChange(LinkChange const&);
+    Event* nextStreamChange(LinkChangeSource&);
+    void streamConfiguredChanges(SimulatorConfig const&);
+    void runParallel(double);
+    void runWindow(Partition&, double, Event const*);
+    std::size_t pendingEvents() const;
+    void dumpMetrics(bool);
+    void schedulePacket(RouterPacket*);
+    void dropPacket(RouterPacket*, LinkModel::Outcome);
+    void reportTables(double);
+    void reportChanges(int);
+    void traceEvent(Event*);
+    void traceSend(Event*);
+    void traceDrop(RouterPacket const&, LinkModel::Outcome);
+    std::uint64_t tracePayload(RouterPacket const&);
+
     GuiTextArea myGUI;
-    Event* evlist;
-    std::vector<std::vector<int>> connectcosts;
-    std::vector<RouterNode> nodes;
+    std::vector<Partition> partitions;
+    std::vector<Event*> linkEvents;
+    std::vector<LinkStream> linkStreams;
+    RandomChurn* churn{ nullptr }; /* in linkStreams, set with CHURNRATE */
+    long nextSeq{ 0 };
+    std::vector<double> lastArrival; /* latest arrival time per node */
+    std::unique_ptr<LinkModel> linkModel; /* set with LATENCY */
+    Topology topology;
+    std::vector<int> nodePartitions; /* partition of every node */
+    std::vector<std::unique_ptr<Router>> nodes;
     double clocktime;
+    // Delay streams per source node, sorted by destination
+    std::vector<std::vector<std::pair<int, LinkRandom>>> linkRandom;
+
+    SimulationStats stats;
+    std::unique_ptr<TraceWriter> traceWriter; /* set with TRACEFILE */
+    std::unique_ptr<SimulatorMetrics> metrics; /* set with METRICSFILE */
+    // Routes of every node as last printed by reportChanges, N x N
+    std::vector<int> reportedDistances;
+    std::vector<int> reportedHops;
+    double nextReport{ 0.0 }; /* time of the next REPORTINTERVAL tables */
+    std::atomic<bool> stopped{ false }; /* set by stop() */
 
     // possible events:
     const int FROM_LAYER2 = 2;
+    const int TIMER = 3;
     const int LINK_CHANGE = 10;
+
+    // Packets take at least this long to cross a link and timers are set at
+    // least this far ahead, so events less than LOOKAHEAD apart cannot affect
+    // each other in the parallel simulation.
+    const double LOOKAHEAD;
+
+    // Random churn gives links costs in [1, CHURN_MAX_COST]
+    const int CHURN_MAX_COST = 10;
 };
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "LinkRandom.h"
+#include "Snapshot.h"
+#include "Topology.h"
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * A stream of link changes in time order. RouterSimulator only asks for the
+ * next change once the previous one was simulated, so a long scenario never
+ * sits in the event list as a whole.
+ */
+class LinkChangeSource {
+public:
+    virtual ~LinkChangeSource() = default;
+    // Store the next change in the argument, false when there are no more
+    virtual bool next(LinkChange&) = 0;
+};
+
+/*
+ * Link changes read from a scenario file, one per line:
+ *   <time> change <from> <to> <cost>
+ *   <time> fail <from> <to>
+ *   <time> recover <from> <to> [<cost>]
+ * Times must not decrease. Without a cost, a recovered link gets back the
+ * cost it had before it failed. Empty lines and lines starting with # are
+ * skipped.
+ */
+class ScenarioFile : public LinkChangeSource {
+public:
+    ScenarioFile(std::string const&, Topology, int);
+    bool next(LinkChange&) override;
+
+private:
+    std::string path;
+    std::ifstream file;
+    Topology upCosts; /* last cost below infinity of every link */
+    int infinity;
+    long lineNumber{ 0 };
+    double lastTime{ 0.0 };
+};
+
+/*
+ * Random churn: `rate` link changes per time unit on average, at
+ * exponentially distributed intervals from `begin` until `until`. Every change
+ * picks a random link of the topology. A link that is down recovers with its
+ * previous cost, any other link fails or gets a new cost in [1, maxCost] with
+ * equal probability. Its state is part of snapshots, so a restored simulation
+ * continues the churn of the one it was saved from.
+ */
+class RandomChurn : public LinkChangeSource {
+public:
+    RandomChurn(Topology const&, double, double, double, int, int, long);
+    RandomChurn(SnapshotReader&, long);
+    bool next(LinkChange&) override;
+    void save(SnapshotWriter&) const;
+
+private:
+    std::vector<std::pair<int, int>> links; /* (from, to) with from < to */
+    std::vector<int> costs;                 /* current cost per link */
+    std::vector<int> upCosts;               /* cost before failing */
+    LinkRandom random;
+    double rate;
+    double time;
+    double until;
+    int maxCost;
+    int infinity;
+};
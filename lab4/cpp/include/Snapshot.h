@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Binary checkpoint of a simulation, see RouterSimulator::saveSnapshot.
+ *
+ * A snapshot is a header followed by plain values and arrays in native byte
+ * order, each array prefixed by its length. Arrays are stored contiguously,
+ * so restoring a large distance table is a single copy out of the mapped
+ * file. Snapshots are meant to be restored by the same build on the same
+ * machine they were saved on.
+ */
+// Values that can be stored as their bytes. This admits std::pair of such
+// values, which is not trivially copyable only because of its operator=.
+template <typename T>
+constexpr bool isSnapshotValue = std::is_trivially_copy_constructible_v<T> &&
+                                 std::is_trivially_destructible_v<T>;
+
+class SnapshotWriter {
+public:
+    template <typename T>
+    void put(T const& value) {
+        static_assert(isSnapshotValue<T>);
+        char const* bytes = reinterpret_cast<char const*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    void putVector(std::vector<T> const& values) {
+        static_assert(isSnapshotValue<T>);
+        put<std::uint64_t>(values.size());
+        char const* bytes = reinterpret_cast<char const*>(values.data());
+        buffer.insert(buffer.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    void save(std::string const&) const;
+
+private:
+    std::vector<char> buffer;
+};
+
+class SnapshotReader {
+public:
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader(SnapshotReader&&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(SnapshotReader&&) = delete;
+
+    explicit SnapshotReader(std::string const&);
+    ~SnapshotReader();
+
+    template <typename T>
+    T get() {
+        static_assert(isSnapshotValue<T>);
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    std::vector<T> getVector() {
+        static_assert(isSnapshotValue<T>);
+        std::uint64_t count = get<std::uint64_t>();
+        if (count > (size - offset) / sizeof(T)) {
+            corrupt();
+        }
+        std::vector<T> values(count);
+        if (count > 0) {
+            std::memcpy(static_cast<void*>(values.data()),
+                        take(count * sizeof(T)),
+                        count * sizeof(T));
+        }
+        return values;
+    }
+
+private:
+    char const* take(std::size_t);
+    [[noreturn]] void corrupt() const;
+
+    std::string path;
+    char const* data;
+    std::size_t size;
+    std::size_t offset{ 0 };
+};
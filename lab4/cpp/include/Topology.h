@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Snapshot.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// A scheduled change of the cost of the link between two nodes
+struct LinkChange {
+    double time;
+    int from;
+    int to;
+    int cost;
+};
+
+/*
+ * Undirected network topology stored as sorted adjacency lists of
+ * (neighbor, cost) pairs, so memory grows with the number of links instead of
+ * with the square of the number of nodes.
+ */
+class Topology {
+public:
+    explicit Topology(int);
+    static Topology builtin(int);
+    static Topology random(int, int, int, unsigned long);
+    static Topology restore(SnapshotReader&);
+
+    int numNodes() const;
+    std::size_t numLinks() const;
+    int cost(int, int) const;
+    void setCost(int, int, int);
+    std::vector<LinkChange>
+    randomChanges(int, int, int, unsigned long) const;
+    std::vector<std::pair<int, int>> const& links(int) const;
+    std::vector<int> partition(int) const;
+    void save(SnapshotWriter&) const;
+
+private:
+    std::vector<std::vector<std::pair<int, int>>> adjacency;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * Binary event trace, see RouterSimulator::initialize (--tracefile).
+ *
+ * The trace file is a TraceHeader followed by fixed-size TraceRecords. Packet
+ * contents are not part of the records: they are appended to a second file,
+ * `<path>.payload`, and records refer to them by offset. The arrival of a
+ * packet refers to the contents written when it was sent, so every packet is
+ * written once. Like snapshots, traces are in native byte order and meant to
+ * be decoded (by TraceDecoder) on the machine that wrote them.
+ */
+enum TraceType : std::int32_t {
+    TRACE_SEND = 1,        /* a packet was handed to the medium */
+    TRACE_RECV = 2,        /* a packet arrived at its destination */
+    TRACE_LINK_CHANGE = 3, /* the cost of a link changed */
+    TRACE_TIMER = 4,       /* a timer of a node expired */
+    TRACE_DROP = 5         /* the LinkModel did not deliver a packet */
+};
+
+// Why a packet was not delivered, in `entries` of a TRACE_DROP
+enum TraceDropReason : std::int32_t {
+    TRACE_LOST = 1,   /* lost on the link */
+    TRACE_DROPPED = 2 /* dropped at a full link queue */
+};
+
+// How the payload of a packet is laid out
+enum TraceFormat : std::int32_t {
+    TRACE_NO_PAYLOAD = 0,
+    TRACE_COSTS = 1,   /* `entries` ints, one cost per node */
+    TRACE_CHANGES = 2, /* `entries` (destination, cost) int pairs */
+    TRACE_LSA = 3      /* origin and sequence ints, then `entries` pairs */
+};
+
+struct TraceHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::int32_t numNodes;
+};
+
+struct TraceRecord {
+    double time;           /* simulation time of the event */
+    double arrival;        /* TRACE_SEND: when the packet will arrive */
+    std::uint64_t payload; /* offset of the packet in the payload file */
+    std::int32_t type;     /* TraceType */
+    std::int32_t src;      /* sending node, or one end of the link */
+    std::int32_t dst;      /* receiving node, or the other end */
+    std::int32_t entries;  /* packet entries, link cost, timer or reason */
+    std::int32_t format;   /* TraceFormat of the payload */
+    std::int32_t bytes;    /* size of the packet on the wire */
+};
+
+// Both files start with a TraceHeader, so no payload is at offset 0
+const std::uint32_t TRACE_MAGIC = 0x43525452;         /* "RTRC" */
+const std::uint32_t TRACE_PAYLOAD_MAGIC = 0x4C595052; /* "RPYL" */
+const std::uint32_t TRACE_VERSION = 2;
+
+class TraceWriter {
+public:
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter(TraceWriter&&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+    TraceWriter& operator=(TraceWriter&&) = delete;
+
+    TraceWriter(std::string const&, int);
+    ~TraceWriter();
+
+    void record(TraceRecord const&);
+    std::uint64_t payload(void const*, std::size_t);
+    void flush();
+
+private:
+    // An output file with a buffer that is written out when it is full
+    struct Output {
+        explicit Output(std::string const&);
+        void write(void const*, std::size_t);
+        void flush();
+
+        std::string path;
+        std::ofstream file;
+        std::vector<char> buffer;
+        std::uint64_t written{ 0 }; /* bytes written, including the buffer */
+    };
+
+    Output records;
+    Output payloads;
+};
+
+class TraceReader {
+public:
+    TraceReader(const TraceReader&) = delete;
+    TraceReader(TraceReader&&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+    TraceReader& operator=(TraceReader&&) = delete;
+
+    explicit TraceReader(std::string const&);
+
+    TraceHeader const& getHeader() const;
+    bool next(TraceRecord&);
+    std::vector<int> payloadInts(std::uint64_t, std::size_t) const;
+
+private:
+    // A file mapped read-only into memory
+    struct Mapping {
+        explicit Mapping(std::string const&);
+        ~Mapping();
+
+        std::string path;
+        char const* data{ nullptr };
+        std::size_t size{ 0 };
+    };
+
+    Mapping records;
+    Mapping payloads;
+    TraceHeader header;
+    std::size_t offset;
+};
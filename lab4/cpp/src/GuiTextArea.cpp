@@ -1,35 +1,119 @@
 #include "GuiTextArea.h"
 
+#ifndef HEADLESS
 #include <QFont>
 #include <QMainWindow>
 #include <QPlainTextEdit>
 #include <QString>
+#include <QTextCursor>
+#include <QTimer>
+#include <mutex>
+#endif
+#include <algorithm>
+#include <cstddef>
+#include <string>
 
 using namespace std;
 
+#ifdef HEADLESS
+GuiTextArea::GuiTextArea(string const&) {}
+
+GuiTextArea::~GuiTextArea() {}
+
+void GuiTextArea::setMaxLines(int) {}
+
+void GuiTextArea::print(string const&) {}
+#else
+
+// Milliseconds between renders of the queued text
+const int RENDER_INTERVAL = 50;
+
+int GuiTextArea::maxLines = 10000;
+
 /*
- * Set window info and text style to make the window system more user friendly
+ * Set window info and text style to make the window system more user friendly.
+ * Windows have to be created by the thread running the Qt event loop.
  */
 GuiTextArea::GuiTextArea(string const& title)
-    : myGUI{ new QMainWindow }, textedit{ new QPlainTextEdit{ myGUI } } {
+    : myGUI{ new QMainWindow }, textedit{ new QPlainTextEdit{ myGUI } },
+      timer{ new QTimer{ myGUI } } {
     QFont font("Monospace");
     font.setStyleHint(QFont::Monospace);
     textedit->setFont(font);
     textedit->setReadOnly(true);
+    textedit->setMaximumBlockCount(maxLines);
     myGUI->setCentralWidget(textedit);
     myGUI->setMinimumSize(600, 600);
     myGUI->setWindowTitle(QString::fromStdString(title));
     myGUI->show();
+    QObject::connect(timer, &QTimer::timeout, [this] { render(); });
+    timer->start(RENDER_INTERVAL);
+}
+
+/*
+ * The window stays open with what was rendered so far
+ */
+GuiTextArea::~GuiTextArea() {
+    delete timer;
 }
 
 /*
- * Update the text for the window.
- * This is expensive, should prefer to build up strings before calling this!
+ * Lines a window keeps, older lines are dropped. Must be positive, and
+ * applies to windows created after the call.
+ */
+void GuiTextArea::setMaxLines(int lines) {
+    maxLines = lines;
+}
+
+/*
+ * Queue text for the window, it shows up at the next render. Once more than
+ * twice maxLines lines are queued the oldest are dropped down to maxLines, so
+ * the queue stays bounded however fast it is printed to, without moving the
+ * queued text on every line.
  */
 void GuiTextArea::print(string const& s) {
-    textedit->setPlainText(textedit->toPlainText() + QString::fromStdString(s));
+    lock_guard<mutex> lock{ queueMutex };
+    queued += s;
+    queuedLines += count(s.begin(), s.end(), '\n');
+    if (queuedLines > 2 * static_cast<size_t>(maxLines)) {
+        size_t start = 0;
+        for (size_t lines = queuedLines - maxLines; lines > 0; lines--) {
+            start = queued.find('\n', start) + 1;
+        }
+        queued.erase(0, start);
+        queuedLines = maxLines;
+    }
 }
 
+/*
+ * Append the queued text to the window. Lines that would be dropped right
+ * away because of maxLines are skipped.
+ */
+void GuiTextArea::render() {
+    string text;
+    {
+        lock_guard<mutex> lock{ queueMutex };
+        text.swap(queued);
+        queuedLines = 0;
+    }
+    if (text.empty()) {
+        return;
+    }
+    // Find the start of the last maxLines lines, the text ends with a newline
+    size_t start = text.size();
+    for (int lines = 0; lines <= maxLines && start != string::npos; lines++) {
+        start = start == 0 ? string::npos : text.rfind('\n', start - 1);
+    }
+    if (start != string::npos) {
+        text.erase(0, start + 1);
+    }
+    textedit->moveCursor(QTextCursor::End);
+    textedit->insertPlainText(QString::fromStdString(text));
+    textedit->moveCursor(QTextCursor::End);
+}
+
+#endif
+
 void GuiTextArea::println(string const& s) {
     print(s + '\n');
 }
@@ -0,0 +1,175 @@
+#include "LinkModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * A medium of `numNodes` nodes whose links all have the properties
+ * `defaults`
+ */
+LinkModel::LinkModel(LinkProperties const& defaults, int numNodes)
+    : defaults{ defaults }, links(numNodes) {
+    checkProperties(defaults, "the default link properties");
+}
+
+/*
+ * Restore a medium saved by LinkModel::save, with the packets in its queues
+ */
+LinkModel::LinkModel(SnapshotReader& snapshot)
+    : defaults{ snapshot.get<LinkProperties>() },
+      links(snapshot.get<uint64_t>()) {
+    for (vector<Link>& outgoing : links) {
+        outgoing.resize(snapshot.get<uint64_t>());
+        for (Link& link : outgoing) {
+            link.to = snapshot.get<int>();
+            link.properties = snapshot.get<LinkProperties>();
+            vector<double> queue = snapshot.getVector<double>();
+            link.queue.assign(queue.begin(), queue.end());
+            link.lastArrival = snapshot.get<double>();
+        }
+    }
+}
+
+void LinkModel::save(SnapshotWriter& snapshot) const {
+    snapshot.put(defaults);
+    snapshot.put<uint64_t>(links.size());
+    for (vector<Link> const& outgoing : links) {
+        snapshot.put<uint64_t>(outgoing.size());
+        for (Link const& link : outgoing) {
+            snapshot.put(link.to);
+            snapshot.put(link.properties);
+            snapshot.putVector(
+                vector<double>{ link.queue.begin(), link.queue.end() });
+            snapshot.put(link.lastArrival);
+        }
+    }
+}
+
+/*
+ * Panic unless a link with `properties` can carry packets
+ */
+void LinkModel::checkProperties(LinkProperties const& properties,
+                                string const& where) {
+    if (!(properties.latency > 0.0) || properties.bandwidth < 0.0 ||
+        properties.queueLimit < 0 || properties.loss < 0.0 ||
+        properties.loss >= 1.0) {
+        cerr << "Panic: invalid link properties in " << where << endl;
+        exit(1);
+    }
+}
+
+/*
+ * Read the properties of single links from the link file at `path`
+ */
+void LinkModel::load(string const& path) {
+    ifstream file{ path };
+    if (!file) {
+        cerr << "Panic: could not open link file " << path << endl;
+        exit(1);
+    }
+    string line;
+    long lineNumber = 0;
+    while (getline(file, line)) {
+        lineNumber++;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#') {
+            continue;
+        }
+
+        istringstream fields{ line };
+        int from;
+        int to;
+        LinkProperties properties;
+        fields >> from >> to >> properties.latency >> properties.bandwidth >>
+            properties.queueLimit >> properties.loss;
+        int numNodes = static_cast<int>(links.size());
+        if (fields.fail() || from < 0 || from >= numNodes || to < 0 ||
+            to >= numNodes || from == to) {
+            cerr << "Panic: invalid link at " << path << ':' << lineNumber
+                 << endl;
+            exit(1);
+        }
+        checkProperties(properties, path + ':' + to_string(lineNumber));
+        link(from, to).properties = properties;
+        link(to, from).properties = properties;
+    }
+}
+
+/*
+ * The least latency of any link, the least time a packet is in flight
+ */
+double LinkModel::minLatency() const {
+    double least = defaults.latency;
+    for (vector<Link> const& outgoing : links) {
+        for (Link const& link : outgoing) {
+            least = min(least, link.properties.latency);
+        }
+    }
+    return least;
+}
+
+/*
+ * Hand a packet of `bytes` bytes from `from` to `to` to the medium at time
+ * `now`. Unless it is dropped, `arrival` is set to when it arrives, or would
+ * have arrived if it was not lost. Losses are drawn from `random`, the
+ * stream of the link.
+ */
+LinkModel::Outcome LinkModel::transmit(int from,
+                                       int to,
+                                       size_t bytes,
+                                       double now,
+                                       LinkRandom& random,
+                                       double& arrival) {
+    Link& link = this->link(from, to);
+    LinkProperties const& properties = link.properties;
+    while (!link.queue.empty() && link.queue.front() <= now) {
+        link.queue.pop_front();
+    }
+    if (properties.queueLimit > 0 &&
+        link.queue.size() >= static_cast<size_t>(properties.queueLimit)) {
+        return DROPPED;
+    }
+
+    double sent = link.queue.empty() ? now : link.queue.back();
+    if (properties.bandwidth > 0.0) {
+        sent += static_cast<double>(bytes) / properties.bandwidth;
+    }
+    link.queue.push_back(sent);
+    arrival = sent + properties.latency;
+    if (arrival <= link.lastArrival) {
+        arrival =
+            nextafter(link.lastArrival, numeric_limits<double>::infinity());
+    }
+    link.lastArrival = arrival;
+    if (properties.loss > 0.0 && random.nextDouble() < properties.loss) {
+        return LOST;
+    }
+    return DELIVERED;
+}
+
+/*
+ * The link from `from` to `to`, added with the default properties if it is
+ * new
+ */
+LinkModel::Link& LinkModel::link(int from, int to) {
+    vector<Link>& outgoing = links[from];
+    auto it = lower_bound(
+        outgoing.begin(), outgoing.end(), to, [](Link const& link, int dest) {
+            return link.to < dest;
+        });
+    if (it == outgoing.end() || it->to != to) {
+        it = outgoing.insert(it, Link{ to, defaults, {}, 0.0 });
+    }
+    return *it;
+}
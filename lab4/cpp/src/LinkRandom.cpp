@@ -0,0 +1,42 @@
+#include "LinkRandom.h"
+
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+
+const uint64_t GAMMA = 0x9E3779B97F4A7C15ULL;
+
+uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+} // namespace
+
+LinkRandom::LinkRandom(long seed, int from, int to)
+    : key{ mix64(mix64(static_cast<uint64_t>(seed)) ^
+                 (static_cast<uint64_t>(static_cast<uint32_t>(from)) << 32 |
+                  static_cast<uint32_t>(to))) } {}
+
+/*
+ * The next number of the stream, uniform in [0, 1)
+ */
+double LinkRandom::nextDouble() {
+    counter++;
+    return static_cast<double>(mix64(key + counter * GAMMA) >> 11) * 0x1.0p-53;
+}
+
+/*
+ * How many numbers were drawn, which together with the seed and the link is
+ * the whole state of the stream
+ */
+uint64_t LinkRandom::drawn() const {
+    return counter;
+}
+
+void LinkRandom::setDrawn(uint64_t drawn) {
+    counter = drawn;
+}
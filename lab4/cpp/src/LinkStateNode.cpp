@@ -0,0 +1,327 @@
+#include "LinkStateNode.h"
+#include "RouterPacket.h"
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Initialize the node from its adjacency list of (neighbor, cost) pairs and
+ * flood the first advertisement of its links.
+ */
+LinkStateNode::LinkStateNode(int ID,
+                             RouterSimulator* sim,
+                             vector<pair<int, int>> const& links)
+    : myGUI{ "  Output window for router #" + to_string(ID) + "  " },
+      sim{ sim }, myID{ ID }, links{ links }, sequences(sim->NUM_NODES, 0),
+      lsas(sim->NUM_NODES), myDistances(sim->NUM_NODES, sim->INFINITY),
+      parents(sim->NUM_NODES, -1), firstHops(sim->NUM_NODES, -1) {
+    myDistances[myID] = 0;
+    firstHops[myID] = myID;
+    install(myID, ++mySequence, this->links);
+    flood(myID, -1);
+    if (sim->REFRESH > 0.0) {
+        sim->setTimer(myID, sim->REFRESH, REFRESH_TIMER);
+    }
+}
+
+/*
+ * Restore a LinkStateNode saved by LinkStateNode::save
+ */
+LinkStateNode::LinkStateNode(int ID,
+                             RouterSimulator* sim,
+                             SnapshotReader& snapshot)
+    : myGUI{ "  Output window for router #" + to_string(ID) + "  " },
+      sim{ sim }, myID{ ID } {
+    links = snapshot.getVector<pair<int, int>>();
+    mySequence = snapshot.get<int>();
+    sequences = snapshot.getVector<int>();
+    lsas.resize(sequences.size());
+    for (auto& advertised : lsas) {
+        advertised = snapshot.getVector<pair<int, int>>();
+    }
+    myDistances = snapshot.getVector<int>();
+    parents = snapshot.getVector<int>();
+    firstHops = snapshot.getVector<int>();
+    lastChange = snapshot.get<double>();
+    spfRuns = snapshot.get<long>();
+}
+
+void LinkStateNode::save(SnapshotWriter& snapshot) const {
+    snapshot.putVector(links);
+    snapshot.put(mySequence);
+    snapshot.putVector(sequences);
+    for (auto const& advertised : lsas) {
+        snapshot.putVector(advertised);
+    }
+    snapshot.putVector(myDistances);
+    snapshot.putVector(parents);
+    snapshot.putVector(firstHops);
+    snapshot.put(lastChange);
+    snapshot.put(spfRuns);
+}
+
+/*
+ * Cost of the link from `a` to `b` as advertised by `a`, or INFINITY if
+ * either side does not advertise it. Requiring both sides keeps a link that
+ * went down out of the tree as soon as one end has heard about it.
+ */
+int LinkStateNode::linkCost(int a, int b) const {
+    auto advertisedCost = [this](int from, int to) {
+        auto const& advertised = lsas[from];
+        auto it = lower_bound(advertised.begin(),
+                              advertised.end(),
+                              make_pair(to, 0),
+                              [](auto& x, auto& y) {
+                                  return x.first < y.first;
+                              });
+        if (it == advertised.end() || it->first != to) {
+            return sim->INFINITY;
+        }
+        return it->second;
+    };
+    int cost = advertisedCost(a, b);
+    if (cost >= sim->INFINITY || advertisedCost(b, a) >= sim->INFINITY) {
+        return sim->INFINITY;
+    }
+    return cost;
+}
+
+/*
+ * Store a newer advertisement of `origin` in the database.
+ * SPF only runs again if a link the advertisement changed can alter the
+ * shortest path tree: a link that got cheaper and now gives a shorter path,
+ * or a link of the tree that got more expensive or went down.
+ */
+void LinkStateNode::install(int origin,
+                            int sequence,
+                            vector<pair<int, int>> advertised) {
+    struct Edge {
+        int from;
+        int to;
+        int before;
+    };
+    vector<Edge> edges;
+    for (auto const* list : { &lsas[origin], &advertised }) {
+        for (auto const& [neighbor, cost] : *list) {
+            edges.push_back({ origin, neighbor, linkCost(origin, neighbor) });
+            edges.push_back({ neighbor, origin, linkCost(neighbor, origin) });
+        }
+    }
+    sequences[origin] = sequence;
+    lsas[origin] = std::move(advertised);
+
+    for (Edge const& edge : edges) {
+        int after = linkCost(edge.from, edge.to);
+        bool shorter = after < edge.before &&
+                       myDistances[edge.from] < sim->INFINITY &&
+                       myDistances[edge.from] + after < myDistances[edge.to];
+        bool treeWorse = after > edge.before && parents[edge.to] == edge.from;
+        if (shorter || treeWorse) {
+            runSpf();
+            return;
+        }
+    }
+}
+
+/*
+ * Send the advertisement of `origin` to every neighbor we have a working
+ * link to, except to `except` which we got it from.
+ */
+void LinkStateNode::flood(int origin, int except) {
+    for (auto const& [neighbor, cost] : links) {
+        if (cost >= sim->INFINITY || neighbor == except) {
+            continue;
+        }
+        sim->toLayer2(RouterPacket{
+            myID, neighbor, origin, sequences[origin], lsas[origin] });
+    }
+}
+
+/*
+ * Bring a neighbor whose link just came up in sync with our database, since
+ * it missed everything flooded while the link was down.
+ */
+void LinkStateNode::sendDatabase(int neighbor) {
+    for (int origin = 0; origin < sim->NUM_NODES; origin++) {
+        if (origin == myID || sequences[origin] == 0) {
+            continue;
+        }
+        sim->toLayer2(RouterPacket{
+            myID, neighbor, origin, sequences[origin], lsas[origin] });
+    }
+}
+
+/*
+ * Dijkstra from this node over the link-state database
+ */
+void LinkStateNode::runSpf() {
+    spfRuns++;
+    int numNodes = sim->NUM_NODES;
+    vector<int> dist(numNodes, sim->INFINITY);
+    vector<int> parent(numNodes, -1);
+    vector<int> settled;
+    using Entry = pair<int, int>;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+    dist[myID] = 0;
+    queue.push({ 0, myID });
+    while (!queue.empty()) {
+        auto [cost, node] = queue.top();
+        queue.pop();
+        if (cost > dist[node]) {
+            continue;
+        }
+        settled.push_back(node);
+        for (auto const& [next, advertisedCost] : lsas[node]) {
+            int linkcost = linkCost(node, next);
+            if (linkcost >= sim->INFINITY) {
+                continue;
+            }
+            int through = cost + linkcost;
+            if (through < dist[next] && through < sim->INFINITY) {
+                dist[next] = through;
+                parent[next] = node;
+                queue.push({ through, next });
+            }
+        }
+    }
+
+    // Parents are settled before their children
+    vector<int> hops(numNodes, -1);
+    hops[myID] = myID;
+    for (int node : settled) {
+        if (node != myID) {
+            hops[node] = parent[node] == myID ? node : hops[parent[node]];
+        }
+    }
+    if (dist != myDistances) {
+        lastChange = sim->getClockTime();
+    }
+    myDistances = std::move(dist);
+    parents = std::move(parent);
+    firstHops = std::move(hops);
+}
+
+/*
+ * Install and flood advertisements that are newer than what we have
+ */
+void LinkStateNode::recvUpdate(RouterPacket& pkt) {
+    if (!pkt.isLinkState() || pkt.origin == myID ||
+        pkt.sequence <= sequences[pkt.origin]) {
+        return;
+    }
+    install(pkt.origin, pkt.sequence, pkt.changes);
+    flood(pkt.origin, pkt.sourceid);
+}
+
+/*
+ * Advertise the new cost of one of our links
+ */
+void LinkStateNode::updateLinkCost(int dest, int newcost) {
+    auto it = lower_bound(
+        links.begin(), links.end(), make_pair(dest, 0), [](auto& x, auto& y) {
+            return x.first < y.first;
+        });
+    int oldcost = sim->INFINITY;
+    if (it != links.end() && it->first == dest) {
+        oldcost = it->second;
+        it->second = newcost;
+    } else {
+        links.insert(it, { dest, newcost });
+    }
+    install(myID, ++mySequence, links);
+    flood(myID, -1);
+    if (oldcost >= sim->INFINITY && newcost < sim->INFINITY) {
+        sendDatabase(dest);
+    }
+}
+
+/*
+ * Advertisements are flooded right away, the only timer re-originates our
+ * advertisement with a new sequence, which repairs floods the LinkModel lost
+ * or dropped
+ */
+void LinkStateNode::timerExpired(int timer) {
+    if (timer != REFRESH_TIMER) {
+        return;
+    }
+    install(myID, ++mySequence, links);
+    flood(myID, -1);
+    if (sim->getClockTime() + sim->REFRESH < sim->REFRESHUNTIL) {
+        sim->setTimer(myID, sim->REFRESH, REFRESH_TIMER);
+    }
+}
+
+int LinkStateNode::getDistance(int dest) const {
+    return myDistances[dest];
+}
+
+int LinkStateNode::getFirstHop(int dest) const {
+    return firstHops[dest];
+}
+
+double LinkStateNode::getLastChange() const {
+    return lastChange;
+}
+
+/*
+ * Format and print the link-state database and our routes.
+ */
+void LinkStateNode::printDistanceTable() {
+    ostringstream stringBuilder;
+    stringBuilder << "Current state for " << myID << " at time " << std::fixed
+                  << setprecision(1) << sim->getClockTime() << "\n\n";
+
+    stringBuilder << "Link state database, " << spfRuns << " SPF runs\n";
+    stringBuilder << " origin |  seq | links\n";
+    stringBuilder << "---------------------\n";
+    for (int origin = 0; origin < sim->NUM_NODES; origin++) {
+        if (sequences[origin] == 0) {
+            continue;
+        }
+        stringBuilder << setw(7) << origin << " |" << setw(5)
+                      << sequences[origin] << " |";
+        for (auto const& [neighbor, cost] : lsas[origin]) {
+            stringBuilder << ' ' << neighbor << ':' << cost;
+        }
+        stringBuilder << '\n';
+    }
+    stringBuilder << '\n';
+
+    stringBuilder << "Our distance vector and routes:\n";
+    stringBuilder << "    dst |";
+    for (int i = 0; i < sim->NUM_NODES; i++) {
+        stringBuilder << setw(5) << i;
+    }
+    stringBuilder << '\n';
+
+    stringBuilder << "---------";
+    for (int i = 0; i < sim->NUM_NODES; i++) {
+        stringBuilder << "-----";
+    }
+    stringBuilder << '\n';
+
+    stringBuilder << " cost   |";
+    for (int i = 0; i < sim->NUM_NODES; i++) {
+        stringBuilder << setw(5) << myDistances[i];
+    }
+    stringBuilder << '\n';
+
+    stringBuilder << " route  |";
+    for (int i = 0; i < sim->NUM_NODES; i++) {
+        if (firstHops[i] == -1) {
+            stringBuilder << setw(5) << '-';
+        } else {
+            stringBuilder << setw(5) << firstHops[i];
+        }
+    }
+    stringBuilder << "\n\n";
+    myGUI.println(stringBuilder.str());
+}
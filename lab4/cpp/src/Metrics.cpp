@@ -0,0 +1,180 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Collect metrics of `numNodes` nodes simulated by `numThreads` threads,
+ * dumped to `path` every `interval` wall seconds, or only at the end if it
+ * is 0
+ */
+SimulatorMetrics::SimulatorMetrics(string const& path,
+                                   int numNodes,
+                                   int numThreads,
+                                   double interval)
+    : path{ path }, file{ path, ios::trunc },
+      interval{ chrono::duration_cast<Clock::duration>(
+          chrono::duration<double>{ interval }) },
+      start{ Clock::now() }, nextDump{ start + this->interval },
+      lastDump{ start }, nodeSent(numNodes, 0), nodeReceived(numNodes, 0),
+      nodeSeconds(numNodes, 0.0), outgoing(numNodes), incoming(numNodes),
+      threads(numThreads) {
+    if (!file) {
+        cerr << "Panic: could not open metrics " << path << endl;
+        exit(1);
+    }
+    file << setprecision(10);
+}
+
+/*
+ * The counter of the link to `node` in `links`, added if it is new
+ */
+long& SimulatorMetrics::linkCount(vector<LinkCount>& links, int node) {
+    auto it = lower_bound(
+        links.begin(), links.end(), node, [](LinkCount const& link, int n) {
+            return link.node < n;
+        });
+    if (it == links.end() || it->node != node) {
+        it = links.insert(it, { node, 0 });
+    }
+    return it->packets;
+}
+
+/*
+ * A packet was handed to the medium by `from`
+ */
+void SimulatorMetrics::sent(int from, int to) {
+    nodeSent[from]++;
+    linkCount(outgoing[from], to)++;
+}
+
+/*
+ * A packet sent by `from` arrived at `to`
+ */
+void SimulatorMetrics::received(int from, int to) {
+    nodeReceived[to]++;
+    linkCount(incoming[to], from)++;
+}
+
+/*
+ * Thread `thread` spent `time` in the router of `node`
+ */
+void SimulatorMetrics::nodeTime(int thread, int node, Clock::duration time) {
+    threads[thread].node += time;
+    nodeSeconds[node] += chrono::duration<double>{ time }.count();
+}
+
+/*
+ * Thread `thread` spent `time` on the event list or the medium
+ */
+void SimulatorMetrics::scheduleTime(int thread, Clock::duration time) {
+    threads[thread].schedule += time;
+}
+
+/*
+ * All time measured on thread `thread` so far, to leave out the time of
+ * measured calls nested in a measurement
+ */
+SimulatorMetrics::Clock::duration SimulatorMetrics::measured(
+    int thread) const {
+    return threads[thread].node + threads[thread].schedule;
+}
+
+/*
+ * Sample the number of pending events
+ */
+void SimulatorMetrics::queueDepth(size_t depth) {
+    size_t bucket = 0;
+    while (depth >> bucket != 0) {
+        bucket++;
+    }
+    if (bucket >= depthHistogram.size()) {
+        depthHistogram.resize(bucket + 1, 0);
+    }
+    depthHistogram[bucket]++;
+    maxDepth = max(maxDepth, depth);
+}
+
+/*
+ * Whether the next periodic dump is due
+ */
+bool SimulatorMetrics::due() const {
+    return interval > Clock::duration::zero() && Clock::now() >= nextDump;
+}
+
+/*
+ * Write a line with the metrics so far, at simulation time `time` after
+ * `events` events with `depth` events pending. The last dump, `final`, also
+ * has the counters of every node and link.
+ */
+void SimulatorMetrics::dump(double time,
+                            long events,
+                            size_t depth,
+                            bool final) {
+    Clock::time_point now = Clock::now();
+    double wall = chrono::duration<double>{ now - start }.count();
+    double sinceLast = chrono::duration<double>{ now - lastDump }.count();
+    double nodeTotal = 0.0;
+    double scheduleTotal = 0.0;
+    for (ThreadTime const& thread : threads) {
+        nodeTotal += chrono::duration<double>{ thread.node }.count();
+        scheduleTotal += chrono::duration<double>{ thread.schedule }.count();
+    }
+    long packets = 0;
+    for (long count : nodeSent) {
+        packets += count;
+    }
+
+    file << "{\"final\": " << boolalpha << final << ", \"wall_seconds\": "
+         << wall << ", \"sim_time\": " << time << ", \"events\": " << events
+         << ", \"events_per_sec\": " << (wall > 0.0 ? events / wall : 0.0)
+         << ", \"recent_events_per_sec\": "
+         << (sinceLast > 0.0 ? (events - lastEvents) / sinceLast : 0.0)
+         << ", \"packets\": " << packets << ", \"queue_depth\": " << depth
+         << ", \"max_queue_depth\": " << maxDepth
+         << ", \"queue_depth_log2_histogram\": [";
+    for (size_t i = 0; i < depthHistogram.size(); i++) {
+        file << (i == 0 ? "" : ", ") << depthHistogram[i];
+    }
+    file << "], \"node_seconds\": " << nodeTotal
+         << ", \"schedule_seconds\": " << scheduleTotal;
+    if (final) {
+        file << ", \"nodes\": [";
+        for (size_t n = 0; n < nodeSent.size(); n++) {
+            file << (n == 0 ? "" : ", ") << "{\"node\": " << n
+                 << ", \"sent\": " << nodeSent[n]
+                 << ", \"received\": " << nodeReceived[n]
+                 << ", \"seconds\": " << nodeSeconds[n] << "}";
+        }
+        file << "], \"links\": [";
+        bool first = true;
+        for (size_t from = 0; from < outgoing.size(); from++) {
+            for (LinkCount const& link : outgoing[from]) {
+                file << (first ? "" : ", ") << "{\"from\": " << from
+                     << ", \"to\": " << link.node
+                     << ", \"sent\": " << link.packets << ", \"received\": "
+                     << linkCount(incoming[link.node], static_cast<int>(from))
+                     << "}";
+                first = false;
+            }
+        }
+        file << "]";
+    }
+    file << "}" << endl;
+    if (!file) {
+        cerr << "Panic: could not write metrics " << path << endl;
+        exit(1);
+    }
+    lastEvents = events;
+    lastDump = now;
+    nextDump = now + interval;
+}
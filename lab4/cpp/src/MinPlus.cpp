@@ -0,0 +1,303 @@
+#include "MinPlus.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MINPLUS_X86
+#endif
+
+using namespace std;
+
+/*
+ * Slot-major loops over contiguous rows, so each row of the matrix is read
+ * sequentially and the compiler is free to vectorize the inner loop.
+ */
+template <typename T>
+static void relaxScalar(T const* linkcosts,
+                        T const* rows,
+                        size_t numRows,
+                        size_t width,
+                        size_t begin,
+                        size_t end,
+                        int infinity,
+                        T* best,
+                        int* bestSlot) {
+    for (size_t d = begin; d < end; d++) {
+        best[d] = static_cast<T>(infinity);
+        bestSlot[d] = -1;
+    }
+    for (size_t s = 0; s < numRows; s++) {
+        int linkcost = linkcosts[s];
+        T const* row = rows + s * width;
+        for (size_t d = begin; d < end; d++) {
+            int sum = linkcost + row[d];
+            sum = sum < infinity ? sum : infinity;
+            if (sum < best[d]) {
+                best[d] = static_cast<T>(sum);
+                bestSlot[d] = static_cast<int>(s);
+            }
+        }
+    }
+}
+
+void minPlusRelaxScalar(int const* linkcosts,
+                        int const* rows,
+                        size_t numRows,
+                        size_t width,
+                        size_t begin,
+                        size_t end,
+                        int infinity,
+                        int* best,
+                        int* bestSlot) {
+    relaxScalar(
+        linkcosts, rows, numRows, width, begin, end, infinity, best, bestSlot);
+}
+
+void minPlusRelaxScalar(uint16_t const* linkcosts,
+                        uint16_t const* rows,
+                        size_t numRows,
+                        size_t width,
+                        size_t begin,
+                        size_t end,
+                        int infinity,
+                        uint16_t* best,
+                        int* bestSlot) {
+    relaxScalar(
+        linkcosts, rows, numRows, width, begin, end, infinity, best, bestSlot);
+}
+
+#ifdef MINPLUS_X86
+/*
+ * The SIMD versions handle 8 (AVX2) or 4 (SSE4.1) destinations per step:
+ * saturate the sums with a vector min against infinity, then use a strict
+ * compare so that ties keep the lowest slot, just like the scalar version.
+ */
+__attribute__((target("avx2"))) static void
+minPlusRelaxAVX2(int const* linkcosts,
+                 int const* rows,
+                 size_t numRows,
+                 size_t width,
+                 size_t begin,
+                 size_t end,
+                 int infinity,
+                 int* best,
+                 int* bestSlot) {
+    __m256i const inf = _mm256_set1_epi32(infinity);
+    size_t d = begin;
+    for (; d + 8 <= end; d += 8) {
+        __m256i minCost = inf;
+        __m256i minSlot = _mm256_set1_epi32(-1);
+        for (size_t s = 0; s < numRows; s++) {
+            __m256i linkcost = _mm256_set1_epi32(linkcosts[s]);
+            __m256i dist = _mm256_loadu_si256(
+                reinterpret_cast<__m256i const*>(rows + s * width + d));
+            __m256i sum = _mm256_min_epi32(_mm256_add_epi32(linkcost, dist),
+                                           inf);
+            __m256i less = _mm256_cmpgt_epi32(minCost, sum);
+            minCost = _mm256_min_epi32(minCost, sum);
+            minSlot = _mm256_blendv_epi8(
+                minSlot, _mm256_set1_epi32(static_cast<int>(s)), less);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(best + d), minCost);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(bestSlot + d), minSlot);
+    }
+    minPlusRelaxScalar(
+        linkcosts, rows, numRows, width, d, end, infinity, best, bestSlot);
+}
+
+__attribute__((target("sse4.1"))) static void
+minPlusRelaxSSE41(int const* linkcosts,
+                  int const* rows,
+                  size_t numRows,
+                  size_t width,
+                  size_t begin,
+                  size_t end,
+                  int infinity,
+                  int* best,
+                  int* bestSlot) {
+    __m128i const inf = _mm_set1_epi32(infinity);
+    size_t d = begin;
+    for (; d + 4 <= end; d += 4) {
+        __m128i minCost = inf;
+        __m128i minSlot = _mm_set1_epi32(-1);
+        for (size_t s = 0; s < numRows; s++) {
+            __m128i linkcost = _mm_set1_epi32(linkcosts[s]);
+            __m128i dist = _mm_loadu_si128(
+                reinterpret_cast<__m128i const*>(rows + s * width + d));
+            __m128i sum = _mm_min_epi32(_mm_add_epi32(linkcost, dist), inf);
+            __m128i less = _mm_cmpgt_epi32(minCost, sum);
+            minCost = _mm_min_epi32(minCost, sum);
+            minSlot = _mm_blendv_epi8(
+                minSlot, _mm_set1_epi32(static_cast<int>(s)), less);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(best + d), minCost);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bestSlot + d), minSlot);
+    }
+    minPlusRelaxScalar(
+        linkcosts, rows, numRows, width, d, end, infinity, best, bestSlot);
+}
+
+/*
+ * The 16 bit versions handle 16 (AVX2) or 8 (SSE4.1) destinations per step.
+ * Sums saturate at 65535 in the add itself and then at infinity. There is no
+ * unsigned compare, so a sum is less than the minimum so far when taking
+ * their minimum changes it. Slots are 16 bit lanes too, widened to int with
+ * their sign (so -1 stays -1) when stored.
+ */
+__attribute__((target("avx2"))) static void
+minPlusRelax16AVX2(uint16_t const* linkcosts,
+                   uint16_t const* rows,
+                   size_t numRows,
+                   size_t width,
+                   size_t begin,
+                   size_t end,
+                   int infinity,
+                   uint16_t* best,
+                   int* bestSlot) {
+    __m256i const inf = _mm256_set1_epi16(static_cast<short>(infinity));
+    size_t d = begin;
+    for (; d + 16 <= end; d += 16) {
+        __m256i minCost = inf;
+        __m256i minSlot = _mm256_set1_epi16(-1);
+        for (size_t s = 0; s < numRows; s++) {
+            __m256i linkcost =
+                _mm256_set1_epi16(static_cast<short>(linkcosts[s]));
+            __m256i dist = _mm256_loadu_si256(
+                reinterpret_cast<__m256i const*>(rows + s * width + d));
+            __m256i sum = _mm256_min_epu16(_mm256_adds_epu16(linkcost, dist),
+                                           inf);
+            __m256i newMin = _mm256_min_epu16(minCost, sum);
+            __m256i same = _mm256_cmpeq_epi16(newMin, minCost);
+            minSlot = _mm256_blendv_epi8(
+                _mm256_set1_epi16(static_cast<short>(s)), minSlot, same);
+            minCost = newMin;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(best + d), minCost);
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(bestSlot + d),
+            _mm256_cvtepi16_epi32(_mm256_castsi256_si128(minSlot)));
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(bestSlot + d + 8),
+            _mm256_cvtepi16_epi32(_mm256_extracti128_si256(minSlot, 1)));
+    }
+    minPlusRelaxScalar(
+        linkcosts, rows, numRows, width, d, end, infinity, best, bestSlot);
+}
+
+__attribute__((target("sse4.1"))) static void
+minPlusRelax16SSE41(uint16_t const* linkcosts,
+                    uint16_t const* rows,
+                    size_t numRows,
+                    size_t width,
+                    size_t begin,
+                    size_t end,
+                    int infinity,
+                    uint16_t* best,
+                    int* bestSlot) {
+    __m128i const inf = _mm_set1_epi16(static_cast<short>(infinity));
+    size_t d = begin;
+    for (; d + 8 <= end; d += 8) {
+        __m128i minCost = inf;
+        __m128i minSlot = _mm_set1_epi16(-1);
+        for (size_t s = 0; s < numRows; s++) {
+            __m128i linkcost = _mm_set1_epi16(static_cast<short>(linkcosts[s]));
+            __m128i dist = _mm_loadu_si128(
+                reinterpret_cast<__m128i const*>(rows + s * width + d));
+            __m128i sum = _mm_min_epu16(_mm_adds_epu16(linkcost, dist), inf);
+            __m128i newMin = _mm_min_epu16(minCost, sum);
+            __m128i same = _mm_cmpeq_epi16(newMin, minCost);
+            minSlot = _mm_blendv_epi8(
+                _mm_set1_epi16(static_cast<short>(s)), minSlot, same);
+            minCost = newMin;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(best + d), minCost);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bestSlot + d),
+                         _mm_cvtepi16_epi32(minSlot));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bestSlot + d + 4),
+                         _mm_cvtepi16_epi32(_mm_srli_si128(minSlot, 8)));
+    }
+    minPlusRelaxScalar(
+        linkcosts, rows, numRows, width, d, end, infinity, best, bestSlot);
+}
+#endif
+
+using MinPlusFn = void (*)(int const*,
+                           int const*,
+                           size_t,
+                           size_t,
+                           size_t,
+                           size_t,
+                           int,
+                           int*,
+                           int*);
+
+using MinPlus16Fn = void (*)(uint16_t const*,
+                             uint16_t const*,
+                             size_t,
+                             size_t,
+                             size_t,
+                             size_t,
+                             int,
+                             uint16_t*,
+                             int*);
+
+struct MinPlusImpl {
+    MinPlusFn fn;
+    MinPlus16Fn fn16;
+    char const* name;
+};
+
+/*
+ * Pick the widest implementation the CPU supports, once.
+ */
+static MinPlusImpl const& selectImplementation() {
+    static MinPlusImpl const impl = []() -> MinPlusImpl {
+#ifdef MINPLUS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return { minPlusRelaxAVX2, minPlusRelax16AVX2, "avx2" };
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return { minPlusRelaxSSE41, minPlusRelax16SSE41, "sse4.1" };
+        }
+#endif
+        return { minPlusRelaxScalar, minPlusRelaxScalar, "scalar" };
+    }();
+    return impl;
+}
+
+void minPlusRelax(int const* linkcosts,
+                  int const* rows,
+                  size_t numRows,
+                  size_t width,
+                  size_t begin,
+                  size_t end,
+                  int infinity,
+                  int* best,
+                  int* bestSlot) {
+    selectImplementation().fn(
+        linkcosts, rows, numRows, width, begin, end, infinity, best, bestSlot);
+}
+
+void minPlusRelax(uint16_t const* linkcosts,
+                  uint16_t const* rows,
+                  size_t numRows,
+                  size_t width,
+                  size_t begin,
+                  size_t end,
+                  int infinity,
+                  uint16_t* best,
+                  int* bestSlot) {
+    // The SIMD versions keep slots in 16 bit lanes
+    MinPlus16Fn fn16 = selectImplementation().fn16;
+    if (numRows > 32767) {
+        fn16 = minPlusRelaxScalar;
+    }
+    fn16(linkcosts, rows, numRows, width, begin, end, infinity, best, bestSlot);
+}
+
+char const* minPlusImplementation() {
+    return selectImplementation().name;
+}
@@ -0,0 +1,191 @@
+#include "Renumbering.h"
+#include "Scenario.h"
+#include "Topology.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/*
+ * The nodes reachable from `start` that are not `visited` yet, breadth first,
+ * marking them visited. With `byDegree` the neighbors of every node are taken
+ * in order of increasing degree, as Cuthill-McKee does.
+ */
+static vector<int> breadthFirst(Topology const& topology,
+                                int start,
+                                bool byDegree,
+                                vector<bool>& visited) {
+    vector<int> order{ start };
+    visited[start] = true;
+    vector<int> next;
+    for (size_t i = 0; i < order.size(); i++) {
+        next.clear();
+        for (auto const& [neighbor, cost] : topology.links(order[i])) {
+            if (!visited[neighbor]) {
+                visited[neighbor] = true;
+                next.push_back(neighbor);
+            }
+        }
+        if (byDegree) {
+            stable_sort(next.begin(), next.end(), [&](int a, int b) {
+                return topology.links(a).size() < topology.links(b).size();
+            });
+        }
+        order.insert(order.end(), next.begin(), next.end());
+    }
+    return order;
+}
+
+/*
+ * A node far from every other in the component of `start`, found as George
+ * and Liu do: start over from a node of least degree in the last level of a
+ * breadth first search, as long as that makes the search deeper. Cuthill-McKee
+ * from such a node gives narrow levels, so linked nodes get close IDs.
+ *
+ * `level` has an entry of -1 for every node of the topology, and is left
+ * that way. Only the nodes of the component are reset after every search, so
+ * the work is in proportion to the component and not to the topology.
+ */
+static int
+peripheralNode(Topology const& topology, int start, vector<int>& level) {
+    int depth = -1;
+    while (true) {
+        level[start] = 0;
+        vector<int> queue{ start };
+        for (size_t i = 0; i < queue.size(); i++) {
+            for (auto const& [neighbor, cost] : topology.links(queue[i])) {
+                if (level[neighbor] == -1) {
+                    level[neighbor] = level[queue[i]] + 1;
+                    queue.push_back(neighbor);
+                }
+            }
+        }
+        int last = level[queue.back()];
+        int candidate = queue.back();
+        for (int node : queue) {
+            if (level[node] == last && topology.links(node).size() <
+                                           topology.links(candidate).size()) {
+                candidate = node;
+            }
+        }
+        for (int node : queue) {
+            level[node] = -1;
+        }
+        if (last <= depth) {
+            return start;
+        }
+        depth = last;
+        start = candidate;
+    }
+}
+
+/*
+ * Order the nodes of `topology` by `order`, component by component
+ */
+Renumbering::Renumbering(Topology const& topology, NodeOrder order)
+    : newIDs(topology.numNodes()) {
+    int numNodes = topology.numNodes();
+    originalIDs.reserve(numNodes);
+    vector<bool> visited(numNodes, false);
+    vector<int> level(numNodes, -1); /* scratch for peripheralNode */
+    for (int node = 0; node < numNodes; node++) {
+        if (order == NodeOrder::None) {
+            originalIDs.push_back(node);
+        } else if (!visited[node]) {
+            bool rcm = order == NodeOrder::RCM;
+            int start = rcm ? peripheralNode(topology, node, level) : node;
+            vector<int> component =
+                breadthFirst(topology, start, rcm, visited);
+            if (rcm) {
+                reverse(component.begin(), component.end());
+            }
+            originalIDs.insert(
+                originalIDs.end(), component.begin(), component.end());
+        }
+    }
+    for (int id = 0; id < numNodes; id++) {
+        newIDs[originalIDs[id]] = id;
+    }
+}
+
+/*
+ * The new ID of node `original`
+ */
+int Renumbering::renumbered(int original) const {
+    return newIDs[original];
+}
+
+/*
+ * The original ID of node `renumbered`
+ */
+int Renumbering::original(int renumbered) const {
+    return originalIDs[renumbered];
+}
+
+/*
+ * `topology` with node `i` called `ids[i]`
+ */
+static Topology relabel(Topology const& topology, vector<int> const& ids) {
+    Topology result{ topology.numNodes() };
+    for (int from = 0; from < topology.numNodes(); from++) {
+        for (auto const& [to, cost] : topology.links(from)) {
+            if (from < to) {
+                result.setCost(ids[from], ids[to], cost);
+            }
+        }
+    }
+    return result;
+}
+
+/*
+ * `topology` with the new IDs
+ */
+Topology Renumbering::renumbered(Topology const& topology) const {
+    return relabel(topology, newIDs);
+}
+
+/*
+ * A renumbered `topology` with the original IDs, for instance the final
+ * topology of a simulation
+ */
+Topology Renumbering::original(Topology const& topology) const {
+    return relabel(topology, originalIDs);
+}
+
+/*
+ * `changes` with the new IDs
+ */
+vector<LinkChange>
+Renumbering::renumbered(vector<LinkChange> const& changes) const {
+    vector<LinkChange> result = changes;
+    for (LinkChange& change : result) {
+        change.from = newIDs[change.from];
+        change.to = newIDs[change.to];
+    }
+    return result;
+}
+
+/*
+ * The changes of `source` with the new IDs, as they are streamed
+ */
+unique_ptr<LinkChangeSource>
+Renumbering::renumbered(unique_ptr<LinkChangeSource> source) const {
+    return make_unique<RenumberedSource>(std::move(source), *this);
+}
+
+RenumberedSource::RenumberedSource(unique_ptr<LinkChangeSource> source,
+                                   Renumbering renumbering)
+    : source{ std::move(source) }, renumbering{ std::move(renumbering) } {}
+
+bool RenumberedSource::next(LinkChange& change) {
+    if (!source->next(change)) {
+        return false;
+    }
+    change.from = renumbering.renumbered(change.from);
+    change.to = renumbering.renumbered(change.to);
+    return true;
+}
@@ -1,127 +1,663 @@
 #include "RouterNode.h"
+#include "MinPlus.h"
 #include "RouterPacket.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <iomanip>
+#include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 using namespace std;
 
 /*
- * Initialize the RouterNode.
+ * Initialize the RouterNode from its adjacency list of (neighbor, cost) pairs.
  * Also synchronize the base costs on the network before the first LINK_CHANGE
  * event by using the notifyNetwork method.
  */
-RouterNode::RouterNode(int ID, RouterSimulator* sim, vector<int> const& costs)
+template <int FixedNodes>
+RouterNode<FixedNodes>::RouterNode(int ID,
+                                   RouterSimulator* sim,
+                                   vector<pair<int, int>> const& links)
     : myGUI{ "  Output window for router #" + to_string(ID) + "  " },
-      sim{ sim }, myID{ ID }, costs{ costs },
-      distances(sim->NUM_NODES, vector<int>(sim->NUM_NODES, sim->INFINITY)),
-      routes(sim->NUM_NODES, "-") {
+      sim{ sim }, myID{ ID }, myDistances{ makePerNode(toCost(sim->INFINITY)) },
+      firstHops{ makePerNode(-1) }, bestCosts{ makePerNode(Cost{ 0 }) },
+      bestSlots{ makePerNode(0) }, myPaths{ makePerNode(vector<int>{}) },
+      isPending{ makePerNode(false) }, holdUntil{ makePerNode(0.0) },
+      holdCosts{ makePerNode(Cost{ 0 }) } {
 
     // Init distances and routes info.
-    distances[myID] = costs;
-    for (int i = 0; i < sim->NUM_NODES; i++) {
-        if (costs[i] != sim->INFINITY) {
-            routes[i] = to_string(i);
+    myDistances[myID] = 0;
+    firstHops[myID] = myID;
+    if (sim->PATHVECTOR) {
+        myPaths[myID] = { myID };
+    }
+    for (auto const& [neighbor, cost] : links) {
+        addNeighbor(neighbor, cost);
+        myDistances[neighbor] = toCost(cost);
+        if (cost != sim->INFINITY) {
+            firstHops[neighbor] = neighbor;
+            if (sim->PATHVECTOR) {
+                myPaths[neighbor] = { myID, neighbor };
+            }
         }
     }
 
     // Notify the network about the starting costs of this node
-    notifyNetwork();
+    notifyNetwork({});
+    if (sim->REFRESH > 0.0) {
+        sim->setTimer(myID, sim->REFRESH, REFRESH_TIMER);
+    }
+}
+
+/*
+ * Restore a RouterNode saved by RouterNode::save, without notifying the
+ * network: the updates it had sent are still in the restored event list.
+ */
+template <int FixedNodes>
+RouterNode<FixedNodes>::RouterNode(int ID,
+                                   RouterSimulator* sim,
+                                   SnapshotReader& snapshot)
+    : myGUI{ "  Output window for router #" + to_string(ID) + "  " },
+      sim{ sim }, myID{ ID }, bestCosts{ makePerNode(Cost{ 0 }) },
+      bestSlots{ makePerNode(0) },
+      myPaths{ makePerNode(vector<int>{}) }, isPending{ makePerNode(false) } {
+    neighbors = snapshot.getVector<int>();
+    costs = snapshot.getVector<Cost>();
+    distances = snapshot.getVector<Cost>();
+    myDistances = restorePerNode<Cost>(snapshot);
+    firstHops = restorePerNode<int>(snapshot);
+    lastChange = snapshot.get<double>();
+    advertised.resize(neighbors.size());
+    for (vector<Cost>& sent : advertised) {
+        sent = snapshot.getVector<Cost>();
+    }
+    poisoned = snapshot.getVector<int>();
+    pending = snapshot.getVector<int>();
+    pendingPoison = snapshot.get<int>();
+    sendTimerSet = snapshot.get<bool>();
+    holdUntil = restorePerNode<double>(snapshot);
+    holdCosts = restorePerNode<Cost>(snapshot);
+    held = snapshot.getVector<int>();
+    for (vector<int>& path : myPaths) {
+        path = snapshot.getVector<int>();
+    }
+    neighborPaths.resize(snapshot.get<uint64_t>());
+    for (vector<int>& path : neighborPaths) {
+        path = snapshot.getVector<int>();
+    }
+
+    for (int dest : pending) {
+        isPending[dest] = true;
+    }
+}
+
+// The entries of a table with one entry per destination
+template <typename Table>
+static vector<typename Table::value_type> entries(Table const& table) {
+    return { table.begin(), table.end() };
 }
 
 /*
- * Recalculate the distance costs to all destinations for this node by using:
+ * Append the state of this node to a snapshot. Tables are saved as vectors
+ * whether their size is fixed or not, so the same snapshot restores either
+ * variant.
+ */
+template <int FixedNodes>
+void RouterNode<FixedNodes>::save(SnapshotWriter& snapshot) const {
+    snapshot.putVector(neighbors);
+    snapshot.putVector(costs);
+    snapshot.putVector(distances);
+    snapshot.putVector(entries(myDistances));
+    snapshot.putVector(entries(firstHops));
+    snapshot.put(lastChange);
+    for (vector<Cost> const& sent : advertised) {
+        snapshot.putVector(sent);
+    }
+    snapshot.putVector(poisoned);
+    snapshot.putVector(pending);
+    snapshot.put(pendingPoison);
+    snapshot.put(sendTimerSet);
+    snapshot.putVector(entries(holdUntil));
+    snapshot.putVector(entries(holdCosts));
+    snapshot.putVector(held);
+    for (vector<int> const& path : myPaths) {
+        snapshot.putVector(path);
+    }
+    snapshot.put<uint64_t>(neighborPaths.size());
+    for (vector<int> const& path : neighborPaths) {
+        snapshot.putVector(path);
+    }
+}
+
+/*
+ * The number of nodes in the network, a constant if it is fixed
+ */
+template <int FixedNodes>
+int RouterNode<FixedNodes>::numNodes() const {
+    if constexpr (FixedNodes == 0) {
+        return sim->NUM_NODES;
+    } else {
+        return FixedNodes;
+    }
+}
+
+/*
+ * A table with `value` for every destination
+ */
+template <int FixedNodes>
+template <typename T>
+auto RouterNode<FixedNodes>::makePerNode(T const& value) const -> PerNode<T> {
+    if constexpr (FixedNodes == 0) {
+        return PerNode<T>(sim->NUM_NODES, value);
+    } else {
+        PerNode<T> table{};
+        table.fill(value);
+        return table;
+    }
+}
+
+/*
+ * Read a table with an entry per destination saved by RouterNode::save
+ */
+template <int FixedNodes>
+template <typename T>
+auto RouterNode<FixedNodes>::restorePerNode(SnapshotReader& snapshot) const
+    -> PerNode<T> {
+    vector<T> values = snapshot.getVector<T>();
+    if (static_cast<int>(values.size()) != numNodes()) {
+        cerr << "Panic: snapshot has " << values.size()
+             << " destinations for a network of " << numNodes() << endl;
+        exit(1);
+    }
+    if constexpr (FixedNodes == 0) {
+        return values;
+    } else {
+        PerNode<T> table{};
+        copy(values.begin(), values.end(), table.begin());
+        return table;
+    }
+}
+
+/*
+ * A cost from a packet or a link as a Cost, saturated at INFINITY
+ */
+template <int FixedNodes>
+Cost RouterNode<FixedNodes>::toCost(int cost) const {
+    return static_cast<Cost>(clamp(cost, 0, sim->INFINITY));
+}
+
+/*
+ * Find the slot of a neighbor in the per-neighbor vectors, or -1 if `ID` has
+ * never been adjacent to this node.
+ */
+template <int FixedNodes>
+int RouterNode<FixedNodes>::neighborSlot(int ID) const {
+    auto it = lower_bound(neighbors.begin(), neighbors.end(), ID);
+    if (it == neighbors.end() || *it != ID) {
+        return -1;
+    }
+    return static_cast<int>(it - neighbors.begin());
+}
+
+/*
+ * Give a new neighbor a slot, keeping `neighbors` sorted so that routes are
+ * still picked and updates are still sent in ascending neighbor ID order.
+ * Apart from its distance to itself, its distance vector is unknown until it
+ * sends us an update.
+ */
+template <int FixedNodes>
+int RouterNode<FixedNodes>::addNeighbor(int ID, int cost) {
+    auto it = lower_bound(neighbors.begin(), neighbors.end(), ID);
+    int slot = static_cast<int>(it - neighbors.begin());
+    neighbors.insert(it, ID);
+    costs.insert(costs.begin() + slot, toCost(cost));
+    distances.insert(distances.begin() + slot * numNodes(),
+                     numNodes(),
+                     toCost(sim->INFINITY));
+    distances[slot * numNodes() + ID] = 0;
+    advertised.insert(advertised.begin() + slot, vector<Cost>{});
+    if (sim->PATHVECTOR) {
+        neighborPaths.insert(
+            neighborPaths.begin() + slot * numNodes(), numNodes(), {});
+        neighborPaths[slot * numNodes() + ID] = { ID };
+    }
+    return slot;
+}
+
+/*
+ * Recalculate the distance costs to the given destinations by using:
  * min{ cost(x -> y) + distance(y -> destination) }
  * where x is ourselves and y is any adjacent neighbor.
+ * Returns the destinations whose cost changed, and with another HORIZON than
+ * Lab or with PATHVECTOR also those whose next hop or path changed.
+ * When many destinations are affected, all of them are recalculated in one
+ * pass over the distance matrix, since the others cannot change anyway.
+ * With HOLDDOWN set, a destination that becomes unreachable is held down:
+ * until the hold-down ends, routes to it are ignored unless they are better
+ * than the route that was lost. This keeps nodes from picking up stale routes
+ * that may lead back through themselves.
  */
-void RouterNode::updateDistanceCosts() {
-    for (int target = 0; target < sim->NUM_NODES; target++) {
+template <int FixedNodes>
+vector<int>
+RouterNode<FixedNodes>::updateDistanceCosts(vector<int> const& targets) {
+    size_t width = myDistances.size();
+    double now = sim->getClockTime();
+    vector<int> changed;
+    auto apply = [&](int target) {
         if (target == myID) {
-            continue;
+            return;
+        }
+        int minCost = bestCosts[target];
+        int minFirstHopID =
+            bestSlots[target] == -1 ? -1 : neighbors[bestSlots[target]];
+        if (holding(target, now) && minCost >= holdCosts[target]) {
+            minCost = sim->INFINITY;
+            minFirstHopID = -1;
+        } else if (holding(target, now)) {
+            // A better route than the lost one ends the hold-down, the timer
+            // still removes it from `held`
+            holdUntil[target] = now;
+        } else if (sim->HOLDDOWN > 0.0 && minCost >= sim->INFINITY &&
+                   myDistances[target] < sim->INFINITY) {
+            if (holdUntil[target] == 0.0) {
+                held.push_back(target);
+            }
+            holdUntil[target] = now + sim->HOLDDOWN;
+            holdCosts[target] = myDistances[target];
+            sim->setTimer(myID, sim->HOLDDOWN, HOLDDOWN_TIMER);
+        }
+        bool routeChanged = this->myDistances[target] != minCost;
+        this->myDistances[target] = static_cast<Cost>(minCost);
+        if (this->firstHops[target] != minFirstHopID) {
+            this->firstHops[target] = minFirstHopID;
+            // What the old and the new next hop are told depends on it
+            routeChanged |= sim->HORIZON != Horizon::Lab;
+        }
+        if (sim->PATHVECTOR) {
+            vector<int> path;
+            if (minFirstHopID != -1) {
+                vector<int> const& via =
+                    neighborPaths[bestSlots[target] * numNodes() + target];
+                path.reserve(via.size() + 1);
+                path.push_back(myID);
+                path.insert(path.end(), via.begin(), via.end());
+            }
+            if (myPaths[target] != path) {
+                myPaths[target] = std::move(path);
+                routeChanged = true;
+            }
+        }
+        if (routeChanged) {
+            changed.push_back(target);
+        }
+    };
+
+    if (4 * targets.size() >= width) {
+        relaxAll();
+        for (size_t target = 0; target < width; target++) {
+            apply(static_cast<int>(target));
+        }
+    } else if constexpr (FixedNodes != 0) {
+        // One unrolled pass is cheaper than relaxing targets one at a time
+        relaxAll();
+        for (int target : targets) {
+            apply(target);
         }
-        // Calculate all possible routes so that we can find the cheapest one.
-        // For each cost: save the first hop at the same index.
-        vector<int> targetRoutes;
-        vector<int> targetFirstHops;
-        targetRoutes.reserve(sim->NUM_NODES);
-        targetFirstHops.reserve(sim->NUM_NODES);
-        for (int next = 0; next < sim->NUM_NODES; next++) {
-            if (next == myID) {
-                continue;
+    } else {
+        for (int target : targets) {
+            minPlusRelax(costs.data(),
+                         distances.data(),
+                         neighbors.size(),
+                         width,
+                         target,
+                         target + 1,
+                         sim->INFINITY,
+                         bestCosts.data(),
+                         bestSlots.data());
+            apply(target);
+        }
+    }
+    if (!changed.empty()) {
+        lastChange = sim->getClockTime();
+    }
+    return changed;
+}
+
+/*
+ * Fill bestCosts and bestSlots for every destination
+ */
+template <int FixedNodes>
+void RouterNode<FixedNodes>::relaxAll() {
+    if constexpr (FixedNodes == 0) {
+        minPlusRelax(costs.data(),
+                     distances.data(),
+                     neighbors.size(),
+                     myDistances.size(),
+                     0,
+                     myDistances.size(),
+                     sim->INFINITY,
+                     bestCosts.data(),
+                     bestSlots.data());
+    } else {
+        minPlusRelaxFixed<FixedNodes>(costs.data(),
+                                      distances.data(),
+                                      neighbors.size(),
+                                      sim->INFINITY,
+                                      bestCosts.data(),
+                                      bestSlots.data());
+    }
+}
+
+/*
+ * Our cost to `dest` as advertised to `target`. With split horizon or
+ * poisoned reverse, a route through `target` is advertised as INFINITY, and
+ * split horizon then leaves it out of full updates.
+ */
+template <int FixedNodes>
+int RouterNode<FixedNodes>::advertisedCost(int target, int dest) const {
+    if (sim->HORIZON != Horizon::Lab && firstHops[dest] == target) {
+        return sim->INFINITY;
+    }
+    return myDistances[dest];
+}
+
+/*
+ * The path sent along with an advertised `cost` to `dest`
+ */
+template <int FixedNodes>
+vector<int> const& RouterNode<FixedNodes>::advertisedPath(int dest,
+                                                          int cost) const {
+    static vector<int> const unreachable;
+    return cost < sim->INFINITY ? myPaths[dest] : unreachable;
+}
+
+/*
+ * A packet replacing the distance vector `target` has of us by `sent`. With
+ * split horizon it only lists the reachable destinations.
+ */
+template <int FixedNodes>
+RouterPacket
+RouterNode<FixedNodes>::fullUpdate(int target, vector<Cost> const& sent) const {
+    if (sim->HORIZON != Horizon::Split) {
+        RouterPacket pkt{ myID, target, vector<int>(sent.begin(), sent.end()) };
+        if (sim->PATHVECTOR) {
+            for (int dest = 0; dest < numNodes(); dest++) {
+                pkt.paths.push_back(advertisedPath(dest, sent[dest]));
             }
-            targetRoutes.push_back(costs[next] + distances[next][target]);
-            targetFirstHops.push_back(next);
-        }
-        // Find the minimum cost possible, and its corresponding first hop.
-        int minCost = sim->INFINITY;
-        int minFirstHopID;
-        for (size_t i = 0; i < targetRoutes.size(); i++) {
-            if (targetRoutes[i] < minCost) {
-                minCost = targetRoutes[i];
-                minFirstHopID = targetFirstHops[i];
+        }
+        return pkt;
+    }
+    RouterPacket pkt{ myID, target, vector<pair<int, int>>{} };
+    pkt.complete = true;
+    for (int dest = 0; dest < numNodes(); dest++) {
+        if (sent[dest] < sim->INFINITY) {
+            pkt.changes.emplace_back(dest, sent[dest]);
+            if (sim->PATHVECTOR) {
+                pkt.paths.push_back(advertisedPath(dest, sent[dest]));
             }
         }
-        this->distances[myID][target] = minCost;
-        // Set the route info for informative printing
-        this->routes[target] = to_string(minFirstHopID);
     }
+    return pkt;
 }
 
 /*
  * Send our distances to the entire network
  * If POISONREVERSE is true then we should send INFINITY to any node that we are
  * connected to.
+ * A neighbor only gets the entries that differ from what we last advertised to
+ * it: `changed` holds the destinations whose cost changed, and entries that
+ * were poisoned last time are rechecked so that the poison gets lifted.
+ * Neighbors we have not advertised to since the link came up, or that would
+ * need half of the vector anyway, get the full vector instead.
  * `fakeindex` defaults to a null pointer.
+ * The lab's POISONREVERSE only applies with HORIZON Lab. The other horizons
+ * go by the next hop of every route instead, so `changed` then also holds the
+ * destinations whose next hop changed. With PATHVECTOR it holds those whose
+ * path changed, which are sent even if their cost is the same.
  */
-void RouterNode::notifyNetwork(int* fakeidx) {
-    for (int target = 0; target < sim->NUM_NODES; target++) {
-        // Prepare a vector that we might need to add poisoned data to
-        vector<int> sendvector = distances[myID];
-        if (sim->POISONREVERSE && fakeidx != nullptr && target != *fakeidx) {
-            sendvector[*fakeidx] = sim->INFINITY;
-        }
-        if (target == myID) {
+template <int FixedNodes>
+void RouterNode<FixedNodes>::notifyNetwork(vector<int> const& changed,
+                                           int* fakeidx) {
+    bool poison = sim->HORIZON == Horizon::Lab && sim->POISONREVERSE &&
+                  fakeidx != nullptr;
+    vector<int> candidates = changed;
+    candidates.insert(candidates.end(), poisoned.begin(), poisoned.end());
+    poisoned.clear();
+    if (poison) {
+        candidates.push_back(*fakeidx);
+        poisoned.push_back(*fakeidx);
+    }
+
+    for (size_t slot = 0; slot < neighbors.size(); slot++) {
+        if (costs[slot] == sim->INFINITY) {
             continue;
         }
-        if (costs[target] == sim->INFINITY) {
-            continue;
+        int target = neighbors[slot];
+        bool poisonTarget = poison && target != *fakeidx;
+        vector<Cost>& sent = advertised[slot];
+        vector<pair<int, int>> delta;
+        vector<vector<int>> paths;
+        if (!sent.empty()) {
+            for (size_t i = 0; i < candidates.size(); i++) {
+                int dest = candidates[i];
+                int cost = advertisedCost(target, dest);
+                if (poisonTarget && dest == *fakeidx) {
+                    cost = sim->INFINITY;
+                }
+                bool newPath = sim->PATHVECTOR && i < changed.size() &&
+                               cost < sim->INFINITY;
+                if (sent[dest] != cost || newPath) {
+                    sent[dest] = static_cast<Cost>(cost);
+                    delta.emplace_back(dest, cost);
+                    if (sim->PATHVECTOR) {
+                        paths.push_back(advertisedPath(dest, cost));
+                    }
+                }
+            }
+        }
+        if (sent.empty() || 2 * delta.size() >= myDistances.size()) {
+            // Prepare a vector that we might need to add poisoned data to
+            sent.resize(numNodes());
+            for (int dest = 0; dest < numNodes(); dest++) {
+                sent[dest] = static_cast<Cost>(advertisedCost(target, dest));
+            }
+            if (poisonTarget) {
+                sent[*fakeidx] = toCost(sim->INFINITY);
+            }
+            sendUpdate(fullUpdate(target, sent));
+        } else if (!delta.empty()) {
+            RouterPacket pkt{ myID, target, std::move(delta) };
+            pkt.paths = std::move(paths);
+            sendUpdate(std::move(pkt));
+        }
+    }
+}
+
+/*
+ * Send an update for the destinations in `changed`, and poison `fakeidx` as
+ * notifyNetwork does. With UPDATEDELAY set the update waits that long, and
+ * with MININTERVAL set it waits until that long after the previous update.
+ * Changes made while an update waits are merged into it, and it poisons the
+ * link of the last link change.
+ */
+template <int FixedNodes>
+void RouterNode<FixedNodes>::triggerUpdate(vector<int> const& changed,
+                                           int* fakeidx) {
+    if (changed.empty() && fakeidx == nullptr) {
+        return;
+    }
+    for (int dest : changed) {
+        if (!isPending[dest]) {
+            isPending[dest] = true;
+            pending.push_back(dest);
+        }
+    }
+    if (fakeidx != nullptr) {
+        pendingPoison = *fakeidx;
+    }
+    if (sendTimerSet) {
+        // Sent when the timer expires
+        return;
+    }
+    if (sim->UPDATEDELAY > 0.0) {
+        sim->setTimer(myID, sim->UPDATEDELAY, SEND_TIMER);
+        sendTimerSet = true;
+        return;
+    }
+    sendPending();
+}
+
+/*
+ * Send the pending update, if any, and start the MININTERVAL after it
+ */
+template <int FixedNodes>
+void RouterNode<FixedNodes>::sendPending() {
+    if (pending.empty() && pendingPoison == -1) {
+        return;
+    }
+    vector<int> changed;
+    changed.swap(pending);
+    for (int dest : changed) {
+        isPending[dest] = false;
+    }
+    int poison = pendingPoison;
+    pendingPoison = -1;
+    notifyNetwork(changed, poison == -1 ? nullptr : &poison);
+    if (sim->MININTERVAL > 0.0) {
+        sim->setTimer(myID, sim->MININTERVAL, SEND_TIMER);
+        sendTimerSet = true;
+    }
+}
+
+/*
+ * Whether `dest` is in hold-down at time `now`
+ */
+template <int FixedNodes>
+bool RouterNode<FixedNodes>::holding(int dest, double now) const {
+    return holdUntil[dest] > now;
+}
+
+/*
+ * A timer set by this node expired: send the pending update, recalculate
+ * the destinations whose hold-down ended, or refresh the neighbors.
+ */
+template <int FixedNodes>
+void RouterNode<FixedNodes>::timerExpired(int timer) {
+    if (timer == SEND_TIMER) {
+        sendTimerSet = false;
+        sendPending();
+    } else if (timer == HOLDDOWN_TIMER) {
+        double now = sim->getClockTime();
+        vector<int> expired;
+        vector<int> stillHeld;
+        for (int dest : held) {
+            if (holding(dest, now)) {
+                stillHeld.push_back(dest);
+            } else {
+                holdUntil[dest] = 0.0;
+                expired.push_back(dest);
+            }
+        }
+        held.swap(stillHeld);
+        triggerUpdate(updateDistanceCosts(expired));
+    } else if (timer == REFRESH_TIMER) {
+        // Forget what we advertised so that every neighbor gets our full
+        // vector, which repairs updates the LinkModel lost or dropped
+        for (vector<Cost>& sent : advertised) {
+            sent.clear();
+        }
+        notifyNetwork({});
+        if (sim->getClockTime() + sim->REFRESH < sim->REFRESHUNTIL) {
+            sim->setTimer(myID, sim->REFRESH, REFRESH_TIMER);
         }
-        RouterPacket pkt{
-            myID,
-            target,
-            std::move(sendvector),
-        };
-        sendUpdate(pkt);
     }
 }
 
 /*
  * When an update is received, update our distance costs and propagate any
  * updated costs, if there is no change, don't propagate.
+ * Only destinations whose entry in the packet differs from what the sender
+ * told us last time can get a new minimum, so only those are recalculated.
  */
-void RouterNode::recvUpdate(RouterPacket& pkt) {
-    distances[pkt.sourceid] = pkt.mincost;
-    vector<vector<int>> oldDistances = distances;
-    updateDistanceCosts();
-    if (oldDistances != distances) {
+template <int FixedNodes>
+void RouterNode<FixedNodes>::recvUpdate(RouterPacket& pkt) {
+    int slot = neighborSlot(pkt.sourceid);
+    if (slot == -1) {
+        // The simulator only delivers packets over existing links
+        return;
+    }
+    Cost* senderDistances = &distances[slot * numNodes()];
+    vector<int> targets;
+    static vector<int> const noPath;
+    auto receive = [&](int target, int cost, size_t entry) {
+        cost = toCost(cost);
+        bool newPath = false;
+        if (sim->PATHVECTOR) {
+            vector<int> const& path =
+                entry < pkt.paths.size() ? pkt.paths[entry] : noPath;
+            // A route that leads back through us is a loop, ignore it
+            if (find(path.begin(), path.end(), myID) != path.end()) {
+                cost = sim->INFINITY;
+            }
+            vector<int>& known = neighborPaths[slot * numNodes() + target];
+            vector<int> const& kept = cost < sim->INFINITY ? path : noPath;
+            if (known != kept) {
+                known = kept;
+                newPath = true;
+            }
+        }
+        if (senderDistances[target] != cost || newPath) {
+            senderDistances[target] = static_cast<Cost>(cost);
+            targets.push_back(target);
+        }
+    };
+    if (pkt.isFull()) {
+        for (int target = 0; target < numNodes(); target++) {
+            receive(target, pkt.mincost[target], target);
+        }
+    } else {
+        vector<bool> listed(pkt.complete ? numNodes() : 0, false);
+        for (size_t entry = 0; entry < pkt.changes.size(); entry++) {
+            auto const& [target, cost] = pkt.changes[entry];
+            receive(target, cost, entry);
+            if (pkt.complete) {
+                listed[target] = true;
+            }
+        }
+        // Split horizon leaves out the destinations routed through us
+        for (int target = 0; target < static_cast<int>(listed.size());
+             target++) {
+            if (!listed[target]) {
+                receive(target, sim->INFINITY, pkt.changes.size());
+            }
+        }
+    }
+    vector<int> changed = updateDistanceCosts(targets);
+    if (!changed.empty()) {
         // Send a regular update to the network, without poisoning any data.
-        notifyNetwork();
+        triggerUpdate(changed);
     }
 }
 
 /*
  * Send a prepared packet to the simulator.
  */
-void RouterNode::sendUpdate(RouterPacket& pkt) {
-    sim->toLayer2(pkt);
+template <int FixedNodes>
+void RouterNode<FixedNodes>::sendUpdate(RouterPacket&& pkt) {
+    sim->toLayer2(std::move(pkt));
 }
 
 /*
  * Format and print state info about this router node.
  */
-void RouterNode::printDistanceTable() {
+template <int FixedNodes>
+void RouterNode<FixedNodes>::printDistanceTable() {
     // Use a string builder to avoid expensive myGUI.print calls
     ostringstream stringBuilder;
     stringBuilder << "Current state for " << myID << " at time " << std::fixed
@@ -129,21 +665,21 @@ void RouterNode::printDistanceTable() {
 
     stringBuilder << "Distancetable\n";
     stringBuilder << "    dst |";
-    for (int i = 0; i < sim->NUM_NODES; i++) {
+    for (int i = 0; i < numNodes(); i++) {
         stringBuilder << setw(5) << i;
     }
     stringBuilder << '\n';
 
     stringBuilder << "---------";
-    for (int i = 0; i < sim->NUM_NODES; i++) {
+    for (int i = 0; i < numNodes(); i++) {
         stringBuilder << "-----";
     }
     stringBuilder << '\n';
 
-    for (int i = 0; i < sim->NUM_NODES; i++) {
-        stringBuilder << " nbr" << setw(4) << i << '|';
-        for (int j = 0; j < sim->NUM_NODES; j++) {
-            stringBuilder << setw(5) << distances[i][j];
+    for (size_t slot = 0; slot < neighbors.size(); slot++) {
+        stringBuilder << " nbr" << setw(4) << neighbors[slot] << '|';
+        for (int j = 0; j < numNodes(); j++) {
+            stringBuilder << setw(5) << distances[slot * numNodes() + j];
         }
         stringBuilder << '\n';
     }
@@ -151,26 +687,30 @@ void RouterNode::printDistanceTable() {
 
     stringBuilder << "Our distance vector and routes:\n";
     stringBuilder << "    dst |";
-    for (int i = 0; i < sim->NUM_NODES; i++) {
+    for (int i = 0; i < numNodes(); i++) {
         stringBuilder << setw(5) << i;
     }
     stringBuilder << '\n';
 
     stringBuilder << "---------";
-    for (int i = 0; i < sim->NUM_NODES; i++) {
+    for (int i = 0; i < numNodes(); i++) {
         stringBuilder << "-----";
     }
     stringBuilder << '\n';
 
     stringBuilder << " cost   |";
-    for (int i = 0; i < sim->NUM_NODES; i++) {
-        stringBuilder << setw(5) << distances[myID][i];
+    for (int i = 0; i < numNodes(); i++) {
+        stringBuilder << setw(5) << myDistances[i];
     }
     stringBuilder << '\n';
 
     stringBuilder << " route  |";
-    for (int i = 0; i < sim->NUM_NODES; i++) {
-        stringBuilder << setw(5) << routes[i];
+    for (int i = 0; i < numNodes(); i++) {
+        if (firstHops[i] == -1) {
+            stringBuilder << setw(5) << '-';
+        } else {
+            stringBuilder << setw(5) << firstHops[i];
+        }
     }
     stringBuilder << "\n\n";
     myGUI.println(stringBuilder.str());
@@ -180,10 +720,62 @@ void RouterNode::printDistanceTable() {
  * Set a new link cost for this node to another node.
  * Since this might cause an update in distance costs when POISONREVERSE is
  * true
+ * A more expensive link can only affect destinations currently routed through
+ * it, while a cheaper link might become the best route to any destination.
  */
-void RouterNode::updateLinkCost(int dest, int newcost) {
-    costs[dest] = newcost;
-    updateDistanceCosts();
+template <int FixedNodes>
+void RouterNode<FixedNodes>::updateLinkCost(int dest, int newcost) {
+    int slot = neighborSlot(dest);
+    int oldcost = sim->INFINITY;
+    if (slot == -1) {
+        addNeighbor(dest, newcost);
+    } else {
+        oldcost = costs[slot];
+        costs[slot] = toCost(newcost);
+        if (newcost == sim->INFINITY) {
+            // Resynchronize with the full vector if the link comes back up
+            advertised[slot].clear();
+        }
+    }
+    vector<int> targets;
+    for (int target = 0; target < numNodes(); target++) {
+        if (newcost < oldcost || firstHops[target] == dest) {
+            targets.push_back(target);
+        }
+    }
+    vector<int> changed = updateDistanceCosts(targets);
     // Pass what node ID to poison data about, if POISONREVERSE is true
-    notifyNetwork(&dest);
+    triggerUpdate(changed, &dest);
+}
+
+/*
+ * Our current cost to `dest`, INFINITY if unreachable.
+ */
+template <int FixedNodes>
+int RouterNode<FixedNodes>::getDistance(int dest) const {
+    return myDistances[dest];
 }
+
+/*
+ * The neighbor we currently route through to `dest`, -1 if unreachable.
+ */
+template <int FixedNodes>
+int RouterNode<FixedNodes>::getFirstHop(int dest) const {
+    return firstHops[dest];
+}
+
+/*
+ * The simulation time our distance vector last changed.
+ */
+template <int FixedNodes>
+double RouterNode<FixedNodes>::getLastChange() const {
+    return lastChange;
+}
+
+template class RouterNode<0>;
+template class RouterNode<3>;
+template class RouterNode<4>;
+template class RouterNode<5>;
+template class RouterNode<6>;
+template class RouterNode<7>;
+template class RouterNode<8>;
@@ -1,6 +1,7 @@
 #include "RouterPacket.h"
 
-#include <algorithm>
+#include <cstddef>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -8,10 +9,59 @@ using namespace std;
 RouterPacket::RouterPacket(int sourceID, int destID, vector<int> mincosts)
     : sourceid{ sourceID }, destid{ destID }, mincost{ std::move(mincosts) } {}
 
+RouterPacket::RouterPacket(int sourceID,
+                           int destID,
+                           vector<pair<int, int>> changes)
+    : sourceid{ sourceID }, destid{ destID }, changes{ std::move(changes) } {}
+
+/*
+ * A link-state advertisement of `origin`, flooded from `sourceID`
+ */
+RouterPacket::RouterPacket(int sourceID,
+                           int destID,
+                           int origin,
+                           int sequence,
+                           vector<pair<int, int>> links)
+    : sourceid{ sourceID }, destid{ destID }, changes{ std::move(links) },
+      origin{ origin }, sequence{ sequence } {}
+
+bool RouterPacket::isFull() const {
+    return !mincost.empty();
+}
+
+/*
+ * Whether the packet replaces the whole distance vector of the sender, with
+ * either all of its costs or all of the reachable ones
+ */
+bool RouterPacket::isComplete() const {
+    return isFull() || complete;
+}
+
+bool RouterPacket::isLinkState() const {
+    return origin != -1;
+}
+
+/*
+ * Number of cost entries carried by the packet
+ */
+size_t RouterPacket::numEntries() const {
+    return isFull() ? mincost.size() : changes.size();
+}
+
 /*
- * Clone packet information and allocate it on the heap to safetly pass it
- * from RouterNode::sendUpdate to RouterSimulator::evlist
+ * Size of the packet on the wire: source, destination and entry count,
+ * followed by either one cost per node or one (destination, cost) pair per
+ * changed entry. Link-state advertisements add their origin and sequence,
+ * and paths add their length and nodes to every entry.
  */
-RouterPacket* RouterPacket::clone() const {
-    return new RouterPacket{ sourceid, destid, vector<int>{ mincost } };
+size_t RouterPacket::size() const {
+    size_t header = (isLinkState() ? 5 : 3) * sizeof(int);
+    size_t pathBytes = 0;
+    for (vector<int> const& path : paths) {
+        pathBytes += (1 + path.size()) * sizeof(int);
+    }
+    if (isFull()) {
+        return header + mincost.size() * sizeof(int) + pathBytes;
+    }
+    return header + changes.size() * 2 * sizeof(int) + pathBytes;
 }
@@ -1,11 +1,25 @@
 #include "RouterSimulator.h"
+#include "Cost.h"
+#include "LinkStateNode.h"
 #include "RouterNode.h"
 #include "RouterPacket.h"
 
+#ifndef HEADLESS
 #include <QApplication>
+#endif
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <getopt.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 /******************************************************************************
@@ -19,13 +33,41 @@
  * -p --poisonreverse    true/false          To activate poison reverse
  * -s --seed               (long)            Random seed
  * -t --trace            1, 2, 3, 4          Debugging levels
+ * -j --threads            (int)             Threads for parallel simulation
+ * -u --until             (double)           Pause before this time
+ * -o --save              (path)             Save a snapshot when done
+ * -r --restore           (path)             Continue from a snapshot
+ * -P --protocol          dv, ls             Distance vector or link state
+ * -f --scenario          (path)             Stream link changes from a file
+ * -k --churn             (double)           Random link changes per time unit
+ * -K --churn-until       (double)           End of random churn (10000)
+ * -T --tracefile         (path)             Write a binary trace
+ * -R --report          full, changes        Tables printed with trace 3
+ * -I --report-interval   (double)           Print all tables this often
+ * -d --update-delay      (double)           Merge updates for this long
+ * -H --holddown          (double)           Hold-down time of worse routes
+ * -m --min-interval      (double)           Least time between updates
+ * -L --gui-lines           (int)             Lines kept per window (10000)
+ * -M --metrics           (path)             Write runtime metrics as JSON
+ * -W --metrics-interval  (double)           Wall seconds between metrics
+ * -l --latency           (double)           Link latency, 0 for random delays
+ * -b --bandwidth         (double)           Link bytes per time unit
+ * -Q --queue              (int)             Packets queued per link
+ * -x --loss              (double)           Packet loss probability
+ * -F --linkfile          (path)             Properties of single links
+ * -e --refresh           (double)           Resend all routes this often
+ * -E --refresh-until     (double)           End of refreshes (10000)
+ * -z --horizon       lab, split, poison     Advertisements to next hops
+ * -i --infinity           (int)             Cost of unreachable routes (999)
+ * -V --path-vector      true/false          Detect loops with paths
  *
  * This is a C++ version by chrlu470 of code provided by Kurose and Ross.
  * Almost all of the code design and comments are taken from their code.
  *
  * This version strives to stay as close as possible to the original Java and
  * Python code with a few differences:
- *   - Windowing system is initialized in RouterSimulator::main
+ *   - Windowing system is initialized in RouterSimulator::main, and the
+ *     simulation runs on a thread of its own
  *   - Events and packets are `delete`d from the heap in
  *     RouterSimulator::runSimulation since C++ does not have garbage collection.
  *   - Long option "--poison" is now called "--poisonreverse"
@@ -33,14 +75,6 @@
  * Entry point: RouterSimulator::main(argc, argv)
  * ***************************************************************************/
 
-/* It's better to NOT change the variables here, but instead use command
- * line arguments (see above) to configure each simulation. */
-long RouterSimulator::SEED = 1234;
-int RouterSimulator::TRACE = 3;
-int RouterSimulator::NUM_NODES = 3;
-bool RouterSimulator::LINKCHANGES = true;
-bool RouterSimulator::POISONREVERSE = true;
-
 /* *************** NETWORK EMULATION CODE STARTS BELOW ******************
  * The code below emulates the layer 2 and below network environment:
  *   - emulates the transmission and delivery (with no loss and no
@@ -57,275 +91,962 @@ bool RouterSimulator::POISONREVERSE = true;
 
 using namespace std;
 
+#ifndef HEADLESS
 void RouterSimulator::main(int argc, char* argv[]) {
     // Initialize the window system Qt5
     QApplication app{ argc, argv };
-    RouterSimulator::initialize(argc, argv);
-    srand(RouterSimulator::SEED);
-    RouterSimulator sim{};
-    sim.runSimulation();
-    // Display windows until student exits them
+    SimulatorConfig config = RouterSimulator::initialize(argc, argv);
+    GuiTextArea::setMaxLines(config.GUILINES);
+    // The windows are created here, by the thread running the event loop
+    optional<RouterSimulator> sim;
+    if (config.RESTOREFILE.empty()) {
+        sim.emplace(config);
+    } else {
+        SnapshotReader snapshot{ config.RESTOREFILE };
+        sim.emplace(config, snapshot);
+    }
+    // Simulate on a thread of its own so the windows stay responsive and
+    // show the output as it is printed
+    thread simulation{ [&] {
+        sim->runSimulation(config.UNTIL);
+        if (!config.SAVEFILE.empty()) {
+            sim->saveSnapshot(config.SAVEFILE);
+        }
+    } };
+    // Display windows until student exits them, then pause the simulation
+    // where it is. It still prints its summary and saves its snapshot.
     app.exec();
+    sim->stop();
+    simulation.join();
 }
+#endif
 
-RouterSimulator::RouterSimulator()
-    : myGUI{ "  Output window for Router Simulator  " }, evlist{ nullptr },
-      connectcosts{
-          vector<vector<int>>(RouterSimulator::NUM_NODES,
-                              vector<int>(RouterSimulator::NUM_NODES)),
-      },
-      clocktime{ 0.0f } {
-    Event* evptr;
-
-    switch (RouterSimulator::NUM_NODES) {
-    case 3: {
-        connectcosts[0][1] = 4;
-        connectcosts[0][2] = 1;
-        connectcosts[1][0] = 4;
-        connectcosts[1][2] = 50;
-        connectcosts[2][0] = 1;
-        connectcosts[2][1] = 50;
-    } break;
-    case 4: {
-        connectcosts[0][1] = 1;
-        connectcosts[0][2] = 3;
-        connectcosts[0][3] = 7;
-        connectcosts[1][0] = 1;
-        connectcosts[1][2] = 1;
-        connectcosts[1][3] = INFINITY;
-        connectcosts[2][0] = 3;
-        connectcosts[2][1] = 1;
-        connectcosts[2][3] = 2;
-        connectcosts[3][0] = 7;
-        connectcosts[3][1] = INFINITY;
-        connectcosts[3][2] = 2;
-    } break;
-    case 5: {
-        connectcosts[0][1] = 1;
-        connectcosts[0][2] = 3;
-        connectcosts[0][3] = 7;
-        connectcosts[0][4] = 1;
-        connectcosts[1][0] = 1;
-        connectcosts[1][2] = 1;
-        connectcosts[1][3] = INFINITY;
-        connectcosts[1][4] = 1;
-        connectcosts[2][0] = 3;
-        connectcosts[2][1] = 1;
-        connectcosts[2][3] = 2;
-        connectcosts[2][4] = 4;
-        connectcosts[3][0] = 7;
-        connectcosts[3][1] = INFINITY;
-        connectcosts[3][2] = 2;
-        connectcosts[3][4] = INFINITY;
-        connectcosts[4][0] = 1;
-        connectcosts[4][1] = 1;
-        connectcosts[4][2] = 4;
-        connectcosts[4][3] = INFINITY;
-    } break;
-    default: {
-        cerr << "Unsupported number of nodes." << endl;
-        exit(0);
-    };
+/*
+ * Simulate the lab topology for NUM_NODES nodes, with its link changes if
+ * LINKCHANGES is set.
+ */
+RouterSimulator::RouterSimulator(SimulatorConfig const& config)
+    : RouterSimulator(config,
+                      Topology::builtin(config.NUM_NODES),
+                      builtinLinkChanges(config)) {}
+
+/*
+ * Simulate any topology with the given link changes. NUM_NODES is taken from
+ * the topology instead of from `config`.
+ */
+RouterSimulator::RouterSimulator(SimulatorConfig const& config,
+                                 Topology topology,
+                                 vector<LinkChange> const& linkChanges)
+    // Braces evaluate the arguments in order, before `topology` is moved
+    : RouterSimulator{ config,
+                       makeLinkModel(config, topology.numNodes()),
+                       std::move(topology) } {
+    nodes.reserve(NUM_NODES);
+    for (int i = 0; i < NUM_NODES; i++) {
+        nodes.push_back(makeRouter(i));
+    }
+    addLinkChanges(linkChanges);
+    streamConfiguredChanges(config);
+}
+
+/*
+ * Continue a simulation from a snapshot written by saveSnapshot. Only TRACE,
+ * THREADS and LINKCHANGES are taken from `config`, the rest is restored,
+ * including the LinkModel.
+ */
+RouterSimulator::RouterSimulator(SimulatorConfig const& config,
+                                 SnapshotReader& snapshot)
+    // Braces evaluate the arguments in order, as they are read from the file
+    : RouterSimulator{ snapshotConfig(config, snapshot),
+                       snapshot.get<bool>()
+                           ? make_unique<LinkModel>(snapshot)
+                           : nullptr,
+                       Topology::restore(snapshot) } {
+    clocktime = snapshot.get<double>();
+    nextSeq = snapshot.get<long>();
+    stats = snapshot.get<SimulationStats>();
+    lastArrival = snapshot.getVector<double>();
+    for (int from = 0; from < NUM_NODES; from++) {
+        for (auto const& [to, drawn] :
+             snapshot.getVector<pair<int, uint64_t>>()) {
+            linkRandom[from].emplace_back(to, LinkRandom{ SEED, from, to });
+            linkRandom[from].back().second.setDrawn(drawn);
+        }
+    }
+
+    nodes.reserve(NUM_NODES);
+    for (int i = 0; i < NUM_NODES; i++) {
+        if (PROTOCOL == Protocol::LinkState) {
+            nodes.push_back(make_unique<LinkStateNode>(i, this, snapshot));
+        } else {
+            nodes.push_back(makeRouterNode(NUM_NODES, i, this, snapshot));
+        }
+    }
+
+    uint64_t numEvents = snapshot.get<uint64_t>();
+    for (uint64_t i = 0; i < numEvents; i++) {
+        Event* evptr = new Event{};
+        evptr->evtime = snapshot.get<double>();
+        evptr->evtype = snapshot.get<int>();
+        evptr->eventity = snapshot.get<int>();
+        evptr->dest = snapshot.get<int>();
+        evptr->cost = snapshot.get<int>();
+        evptr->seq = snapshot.get<long>();
+        evptr->rtpktptr = nullptr;
+        if (evptr->evtype == FROM_LAYER2) {
+            int sourceid = snapshot.get<int>();
+            int destid = snapshot.get<int>();
+            vector<int> mincost = snapshot.getVector<int>();
+            auto changes = snapshot.getVector<pair<int, int>>();
+            bool complete = snapshot.get<bool>();
+            vector<vector<int>> paths(snapshot.get<uint64_t>());
+            for (vector<int>& path : paths) {
+                path = snapshot.getVector<int>();
+            }
+            int origin = snapshot.get<int>();
+            int sequence = snapshot.get<int>();
+            evptr->rtpktptr =
+                mincost.empty()
+                    ? new RouterPacket{ sourceid, destid, std::move(changes) }
+                    : new RouterPacket{ sourceid, destid, std::move(mincost) };
+            evptr->rtpktptr->complete = complete;
+            evptr->rtpktptr->paths = std::move(paths);
+            evptr->rtpktptr->origin = origin;
+            evptr->rtpktptr->sequence = sequence;
+        }
+        pushEvent(evptr);
+    }
+    // The churn continues with the change it had drawn next
+    if (snapshot.get<bool>()) {
+        auto source = make_unique<RandomChurn>(snapshot, SEED);
+        Event* pending = nullptr;
+        if (snapshot.get<bool>()) {
+            pending = scheduleLinkChange(snapshot.get<LinkChange>());
+        }
+        churn = source.get();
+        linkStreams.push_back({ std::move(source), pending });
     }
+    streamConfiguredChanges(config);
+}
 
-    nodes.reserve(RouterSimulator::NUM_NODES);
-    for (int i = 0; i < RouterSimulator::NUM_NODES; i++) {
-        nodes.emplace_back(i, this, connectcosts[i]);
-    }
-
-    if (RouterSimulator::LINKCHANGES) {
-        switch (RouterSimulator::NUM_NODES) {
-        case 3: {
-            evptr = new Event{};
-            evptr->evtime = 40.0;
-            evptr->evtype = LINK_CHANGE;
-            evptr->eventity = 0;
-            evptr->rtpktptr = nullptr;
-            evptr->dest = 1;
-            evptr->cost = 60;
-            insertevent(evptr);
-        } break;
-        case 4:
-        case 5: {
-            connectcosts[0][1] = 1;
-            evptr = new Event{};
-            evptr->evtime = 10000.0;
-            evptr->evtype = LINK_CHANGE;
-            evptr->eventity = 0;
-            evptr->rtpktptr = nullptr;
-            evptr->dest = 3;
-            evptr->cost = 1;
-            insertevent(evptr);
-
-            evptr = new Event{};
-            evptr->evtime = 20000.0;
-            evptr->evtype = LINK_CHANGE;
-            evptr->eventity = 0;
-            evptr->rtpktptr = nullptr;
-            evptr->dest = 1;
-            evptr->cost = 6;
-            insertevent(evptr);
-        } break;
-        default: {
-            cerr << "Panic: Number of nodes outside 3-5" << endl;
-            exit(0);
-        } break;
+/*
+ * The simulator state shared by all constructors, without nodes or events
+ */
+RouterSimulator::RouterSimulator(SimulatorConfig const& config,
+                                 unique_ptr<LinkModel> linkModel,
+                                 Topology topology)
+    : NUM_NODES{ topology.numNodes() }, LINKCHANGES{ config.LINKCHANGES },
+      POISONREVERSE{ config.POISONREVERSE }, SEED{ config.SEED },
+      TRACE{ config.TRACE }, THREADS{ config.THREADS },
+      PROTOCOL{ config.PROTOCOL }, REPORTCHANGES{ config.REPORTCHANGES },
+      REPORTINTERVAL{ config.REPORTINTERVAL },
+      UPDATEDELAY{ config.UPDATEDELAY }, HOLDDOWN{ config.HOLDDOWN },
+      MININTERVAL{ config.MININTERVAL }, REFRESH{ config.REFRESH },
+      REFRESHUNTIL{ config.REFRESHUNTIL }, HORIZON{ config.HORIZON },
+      PATHVECTOR{ config.PATHVECTOR }, INFINITY{ config.INFINITY },
+      myGUI{ "  Output window for Router Simulator  " },
+      partitions(max(1, min(THREADS, NUM_NODES))), lastArrival(NUM_NODES, 0.0),
+      linkModel{ std::move(linkModel) }, topology{ std::move(topology) },
+      nodePartitions{ this->topology.partition(
+          static_cast<int>(partitions.size())) },
+      clocktime{ 0.0f }, linkRandom(NUM_NODES),
+      LOOKAHEAD{ lookahead(config, this->linkModel.get()) } {
+    // Costs must fit in a Cost and their sums in an int, see minPlusRelax
+    if (INFINITY < 2 || INFINITY > MAX_INFINITY) {
+        cerr << "Panic: INFINITY outside 2-" << MAX_INFINITY << endl;
+        exit(1);
+    }
+    if (!config.TRACEFILE.empty()) {
+        traceWriter = make_unique<TraceWriter>(config.TRACEFILE, NUM_NODES);
+    }
+    if (!config.METRICSFILE.empty()) {
+        metrics = make_unique<SimulatorMetrics>(
+            config.METRICSFILE,
+            NUM_NODES,
+            static_cast<int>(partitions.size()),
+            config.METRICSINTERVAL);
+    }
+}
+
+/*
+ * The LinkModel of `config` for `numNodes` nodes, or null to use the random
+ * delays of the lab
+ */
+unique_ptr<LinkModel> RouterSimulator::makeLinkModel(
+    SimulatorConfig const& config,
+    int numNodes) {
+    if (config.LATENCY == 0.0) {
+        if (!config.LINKFILE.empty()) {
+            cerr << "Panic: a link file needs a default latency" << endl;
+            exit(1);
         }
+        return nullptr;
+    }
+    auto linkModel = make_unique<LinkModel>(
+        LinkProperties{
+            config.LATENCY, config.BANDWIDTH, config.QUEUELIMIT, config.LOSS },
+        numNodes);
+    if (!config.LINKFILE.empty()) {
+        linkModel->load(config.LINKFILE);
     }
+    return linkModel;
 }
 
-void RouterSimulator::runSimulation() {
-    Event* eventptr;
-    while (true) {
-        // get next event to simulate
-        eventptr = evlist;
-        if (eventptr == nullptr) {
-            break;
+/*
+ * Packets take at least 1 time unit to arrive, or the least latency of
+ * `linkModel`, timers the shortest delay set
+ */
+double RouterSimulator::lookahead(SimulatorConfig const& config,
+                                  LinkModel const* linkModel) {
+    double least = linkModel != nullptr ? linkModel->minLatency() : 1.0;
+    for (double delay : { config.UPDATEDELAY,
+                          config.HOLDDOWN,
+                          config.MININTERVAL,
+                          config.REFRESH }) {
+        if (delay > 0.0) {
+            least = min(least, delay);
         }
-        evlist = evlist->next;
-        // remove this event from event list
-        if (evlist != nullptr) {
-            evlist->prev = nullptr;
+    }
+    return least;
+}
+
+/*
+ * The routing engine of node `ID`, which gets only the links it actually has
+ */
+unique_ptr<Router> RouterSimulator::makeRouter(int ID) {
+    vector<pair<int, int>> links = topology.links(ID);
+    for (auto& [neighbor, cost] : links) {
+        cost = min(cost, INFINITY);
+    }
+    if (PROTOCOL == Protocol::LinkState) {
+        return make_unique<LinkStateNode>(ID, this, links);
+    }
+    return makeRouterNode(NUM_NODES, ID, this, links);
+}
+
+/*
+ * Schedule more link changes, for instance after restoring a snapshot
+ */
+void RouterSimulator::addLinkChanges(vector<LinkChange> const& linkChanges) {
+    for (LinkChange const& change : linkChanges) {
+        scheduleLinkChange(change);
+    }
+}
+
+/*
+ * Simulate the changes of `source` as well. Only its next change is in the
+ * event list at any time, the one after it is read once that is simulated.
+ * Changes that are not after the last simulated event are skipped, so a
+ * restored simulation can be handed the scenario it was saved in.
+ */
+void RouterSimulator::streamLinkChanges(
+    unique_ptr<LinkChangeSource> source) {
+    Event* pending = nextStreamChange(*source);
+    linkStreams.push_back({ std::move(source), pending });
+}
+
+Event* RouterSimulator::nextStreamChange(LinkChangeSource& source) {
+    LinkChange change;
+    while (source.next(change)) {
+        bool past = stats.eventsProcessed > 0 ? change.time <= clocktime
+                                              : change.time < clocktime;
+        if (!past) {
+            return scheduleLinkChange(change);
         }
-        if (RouterSimulator::TRACE > 1) {
-            myGUI.println("MAIN: rcv event, t=" + to_string(eventptr->evtime) +
-                          " at " + to_string(eventptr->eventity));
-            if (eventptr->evtype == FROM_LAYER2) {
-                myGUI.print(" src:" + to_string(eventptr->rtpktptr->sourceid) +
-                            " dest:" + to_string(eventptr->rtpktptr->destid) +
-                            ", contents:");
-                for (int i = 0; i < RouterSimulator::NUM_NODES; i++) {
-                    myGUI.print(" " +
-                                to_string(eventptr->rtpktptr->mincost[i]));
+    }
+    return nullptr;
+}
+
+/*
+ * Stream the scenario file and random churn asked for on the command line.
+ * Churn restored from a snapshot takes the place of a new one.
+ */
+void RouterSimulator::streamConfiguredChanges(SimulatorConfig const& config) {
+    if (!config.SCENARIOFILE.empty()) {
+        streamLinkChanges(
+            make_unique<ScenarioFile>(config.SCENARIOFILE, topology, INFINITY));
+    }
+    if (config.CHURNRATE > 0.0 && churn == nullptr) {
+        auto source = make_unique<RandomChurn>(topology,
+                                               config.CHURNRATE,
+                                               clocktime,
+                                               config.CHURNUNTIL,
+                                               CHURN_MAX_COST,
+                                               INFINITY,
+                                               SEED);
+        churn = source.get();
+        streamLinkChanges(std::move(source));
+    }
+}
+
+Event* RouterSimulator::scheduleLinkChange(LinkChange const& change) {
+    Event* evptr = new Event{};
+    evptr->evtime = change.time;
+    evptr->evtype = LINK_CHANGE;
+    evptr->eventity = change.from;
+    evptr->rtpktptr = nullptr;
+    evptr->dest = change.to;
+    evptr->cost = change.cost;
+    insertevent(evptr);
+    return evptr;
+}
+
+/*
+ * The link changes of the lab template for NUM_NODES nodes
+ */
+vector<LinkChange>
+RouterSimulator::builtinLinkChanges(SimulatorConfig const& config) {
+    if (!config.LINKCHANGES) {
+        return {};
+    }
+    switch (config.NUM_NODES) {
+    case 3:
+        return { { 40.0, 0, 1, 60 } };
+    case 4:
+    case 5:
+        return { { 10000.0, 0, 3, 1 }, { 20000.0, 0, 1, 6 } };
+    default: {
+        cerr << "Panic: Number of nodes outside 3-5" << endl;
+        exit(0);
+    }
+    }
+}
+
+/*
+ * Simulate the events before `until`, by default all of them. Tracing needs
+ * the events in order, so it is only done by the sequential simulation.
+ */
+void RouterSimulator::runSimulation(double until) {
+    if (partitions.size() > 1 && TRACE <= 1 && traceWriter == nullptr) {
+        runParallel(until);
+    } else {
+        Event* eventptr;
+        // get next event to simulate, removing it from the event list
+        while (!stopped && (eventptr = peekEvent()) != nullptr &&
+               eventptr->evtime < until) {
+            if (metrics != nullptr) {
+                auto start = SimulatorMetrics::Clock::now();
+                popEvent();
+                metrics->scheduleTime(0,
+                                      SimulatorMetrics::Clock::now() - start);
+                metrics->queueDepth(pendingEvents());
+            } else {
+                popEvent();
+            }
+            if (TRACE > 2 && REPORTINTERVAL > 0.0 &&
+                eventptr->evtime >= nextReport) {
+                reportTables(eventptr->evtime);
+            }
+            if (traceWriter != nullptr) {
+                traceEvent(eventptr);
+            }
+            if (TRACE > 1) {
+                myGUI.println("MAIN: rcv event, t=" +
+                              to_string(eventptr->evtime) + " at " +
+                              to_string(eventptr->eventity));
+                if (eventptr->evtype == FROM_LAYER2) {
+                    RouterPacket const& pkt = *eventptr->rtpktptr;
+                    myGUI.print(" src:" + to_string(pkt.sourceid) +
+                                " dest:" + to_string(pkt.destid) +
+                                ", contents:");
+                    for (int cost : pkt.mincost) {
+                        myGUI.print(" " + to_string(cost));
+                    }
+                    for (auto const& [dest, cost] : pkt.changes) {
+                        myGUI.print(" " + to_string(dest) + ":" +
+                                    to_string(cost));
+                    }
+                    myGUI.println();
+                }
+            }
+
+            // update time to next event time
+            clocktime = eventptr->evtime;
+            processEvent(eventptr);
+            stats.eventsProcessed++;
+            if (metrics != nullptr && metrics->due()) {
+                dumpMetrics(false);
+            }
+
+            if (TRACE > 2 && REPORTCHANGES) {
+                // Only the nodes an event occurs at can change their routes
+                reportChanges(eventptr->eventity);
+                if (eventptr->evtype == LINK_CHANGE) {
+                    reportChanges(eventptr->dest);
+                }
+            } else if (TRACE > 2 && REPORTINTERVAL <= 0.0) {
+                for (int i = 0; i < NUM_NODES; i++) {
+                    nodes[i]->printDistanceTable();
                 }
-                myGUI.println();
             }
+
+            // Dispose of this event
+            delete eventptr;
         }
+    }
+    for (auto const& node : nodes) {
+        stats.convergenceTime =
+            max(stats.convergenceTime, node->getLastChange());
+    }
+    if (traceWriter != nullptr) {
+        traceWriter->flush();
+    }
+    if (metrics != nullptr) {
+        dumpMetrics(true);
+    }
+    if (peekEvent() != nullptr) {
+        myGUI.println("\nSimulator paused at t=" + to_string(clocktime));
+    } else {
+        myGUI.println("\nSimulator terminated at t=" + to_string(clocktime) +
+                      ", no packets in medium");
+    }
+    myGUI.println("Sent " + to_string(stats.packetsSent) + " packets, " +
+                  to_string(stats.entriesSent) + " entries, " +
+                  to_string(stats.bytesSent) + " bytes");
+    if (linkModel != nullptr) {
+        myGUI.println("Lost " + to_string(stats.packetsLost) +
+                      " packets, dropped " + to_string(stats.packetsDropped) +
+                      " at full queues");
+    }
+    myGUI.println("Routes last changed at t=" +
+                  to_string(stats.convergenceTime));
+}
 
-        // update time to next event time
-        clocktime = eventptr->evtime;
-        if (eventptr->evtype == FROM_LAYER2) {
-            if (eventptr->eventity >= 0 &&
-                eventptr->eventity < RouterSimulator::NUM_NODES) {
-                nodes[eventptr->eventity].recvUpdate(*eventptr->rtpktptr);
-            } else {
-                cerr << "Panic: unknown event entity" << endl;
-                exit(1);
+/*
+ * Print the tables of all nodes, as they are at the last REPORTINTERVAL
+ * boundary before `time`, and move on to the next boundary after it
+ */
+void RouterSimulator::reportTables(double time) {
+    long intervals = static_cast<long>(time / REPORTINTERVAL);
+    myGUI.println("\nTables at t=" + to_string(intervals * REPORTINTERVAL));
+    for (int i = 0; i < NUM_NODES; i++) {
+        nodes[i]->printDistanceTable();
+    }
+    nextReport = (intervals + 1) * REPORTINTERVAL;
+}
+
+/*
+ * Print the routes of `node` that changed since they were last printed.
+ * Costs one pass over its distance vector, the text follows the changes.
+ */
+void RouterSimulator::reportChanges(int node) {
+    if (reportedDistances.empty()) {
+        reportedDistances.assign(NUM_NODES * NUM_NODES, INFINITY);
+        reportedHops.assign(NUM_NODES * NUM_NODES, -1);
+    }
+    Router const& router = *nodes[node];
+    int* distances = &reportedDistances[node * NUM_NODES];
+    int* hops = &reportedHops[node * NUM_NODES];
+    string line;
+    for (int dest = 0; dest < NUM_NODES; dest++) {
+        int distance = router.getDistance(dest);
+        int hop = router.getFirstHop(dest);
+        if (distance == distances[dest] && hop == hops[dest]) {
+            continue;
+        }
+        distances[dest] = distance;
+        hops[dest] = hop;
+        line += " " + to_string(dest) + ":" + to_string(distance) + " via " +
+                (hop == -1 ? "-" : to_string(hop));
+    }
+    if (!line.empty()) {
+        myGUI.println("    ROUTES: " + to_string(node) + " at t=" +
+                      to_string(clocktime) + line);
+    }
+}
+
+/*
+ * Hand an event to the node(s) it occurs at.
+ */
+void RouterSimulator::processEvent(Event* eventptr) {
+    // The routers are timed without the scheduling of what they send
+    int thread = activePartition == nullptr
+                     ? 0
+                     : static_cast<int>(activePartition - partitions.data());
+    SimulatorMetrics::Clock::time_point start;
+    SimulatorMetrics::Clock::duration measured{ 0 };
+    if (metrics != nullptr) {
+        start = SimulatorMetrics::Clock::now();
+        measured = metrics->measured(thread);
+    }
+
+    if (eventptr->evtype == FROM_LAYER2) {
+        if (eventptr->eventity >= 0 &&
+            eventptr->eventity < NUM_NODES) {
+            if (metrics != nullptr) {
+                metrics->received(eventptr->rtpktptr->sourceid,
+                                  eventptr->eventity);
             }
-            // Dispose of the router packet
-            delete eventptr->rtpktptr;
-        } else if (eventptr->evtype == LINK_CHANGE) {
-            // change link costs here if implemented
-            nodes[eventptr->eventity].updateLinkCost(eventptr->dest,
-                                                     eventptr->cost);
-            nodes[eventptr->dest].updateLinkCost(eventptr->eventity,
-                                                 eventptr->cost);
+            nodes[eventptr->eventity]->recvUpdate(*eventptr->rtpktptr);
         } else {
-            cerr << "Panic: unknown event type" << endl;
+            cerr << "Panic: unknown event entity" << endl;
             exit(1);
         }
-
-        if (RouterSimulator::TRACE > 2) {
-            for (int i = 0; i < RouterSimulator::NUM_NODES; i++) {
-                nodes[i].printDistanceTable();
+        // Dispose of the router packet
+        delete eventptr->rtpktptr;
+    } else if (eventptr->evtype == TIMER) {
+        nodes[eventptr->eventity]->timerExpired(eventptr->dest);
+    } else if (eventptr->evtype == LINK_CHANGE) {
+        // change link costs here if implemented, the topology keeps costs
+        // above a lowered INFINITY
+        topology.setCost(eventptr->eventity, eventptr->dest, eventptr->cost);
+        int cost = min(eventptr->cost, INFINITY);
+        nodes[eventptr->eventity]->updateLinkCost(eventptr->dest, cost);
+        nodes[eventptr->dest]->updateLinkCost(eventptr->eventity, cost);
+        for (LinkStream& stream : linkStreams) {
+            if (stream.pending == eventptr) {
+                stream.pending = nextStreamChange(*stream.source);
             }
         }
+    } else {
+        cerr << "Panic: unknown event type" << endl;
+        exit(1);
+    }
 
-        // Dispose of this event
-        delete eventptr;
+    if (metrics != nullptr) {
+        metrics->nodeTime(thread,
+                          eventptr->eventity,
+                          SimulatorMetrics::Clock::now() - start -
+                              (metrics->measured(thread) - measured));
     }
-    myGUI.println("\nSimulator terminated at t=" + to_string(clocktime) +
-                  ", no packets in medium");
 }
 
+/*
+ * Make runSimulation return after the event or parallel window it is at, as
+ * if it was paused there. Can be called from any thread.
+ */
+void RouterSimulator::stop() {
+    stopped = true;
+}
+
+/*
+ * The time of the event being processed, also inside a parallel window
+ */
 double RouterSimulator::getClockTime() {
+    if (activePartition != nullptr) {
+        return activePartition->lasttime;
+    }
     return clocktime;
 }
 
+SimulationStats const& RouterSimulator::getStats() const {
+    return stats;
+}
+
+/*
+ * The number of events in the event list
+ */
+size_t RouterSimulator::pendingEvents() const {
+    size_t pending = linkEvents.size();
+    for (Partition const& part : partitions) {
+        pending += part.events.size();
+    }
+    return pending;
+}
+
+/*
+ * Write the metrics so far, with every counter if `final`
+ */
+void RouterSimulator::dumpMetrics(bool final) {
+    // Events of a parallel run are only added to the stats when it ends
+    long events = stats.eventsProcessed;
+    for (Partition const& part : partitions) {
+        events += part.processed;
+    }
+    metrics->dump(clocktime, events, pendingEvents(), final);
+}
+
+Router const& RouterSimulator::getNode(int ID) const {
+    return *nodes[ID];
+}
+
+/*
+ * The topology with all link changes simulated so far applied
+ */
+Topology const& RouterSimulator::getTopology() const {
+    return topology;
+}
+
+/* ******************** PARALLEL SIMULATION ************************
+ * Conservative parallel simulation over THREADS partitions of nodes.
+ *
+ * A packet is always in flight for at least LOOKAHEAD time units, so events
+ * in [t, t + LOOKAHEAD) cannot cause each other, where t is the time of the
+ * earliest pending event. Each window like that is simulated with one thread
+ * per partition, every thread only touching the nodes and event heap of its
+ * own partition. Sends made during a window go to the outbox of the sending
+ * partition, which only that thread writes to, so no locks are needed while
+ * the window runs. Between windows the outboxes are scheduled in the order a
+ * sequential run would have sent them, which keeps arrival times, event
+ * order and the random number sequence identical to a sequential run.
+ *
+ * LINK_CHANGE events touch two nodes that may be in different partitions, so
+ * windows stop at the next one and it is processed on its own.
+ * ****************************************************************/
+
+thread_local RouterSimulator::Partition* RouterSimulator::activePartition =
+    nullptr;
+
+void RouterSimulator::runParallel(double until) {
+    mutex windowMutex;
+    condition_variable windowStart;
+    condition_variable windowDone;
+    long generation = 0;
+    size_t running = 0;
+    bool finished = false;
+    double windowEnd = 0.0;
+    Event const* limit = nullptr;
+
+    // Partition 0 is simulated by this thread, the rest get a worker each
+    vector<thread> workers;
+    for (size_t p = 1; p < partitions.size(); p++) {
+        workers.emplace_back([&, p] {
+            long seen = 0;
+            while (true) {
+                unique_lock<mutex> lock{ windowMutex };
+                windowStart.wait(
+                    lock, [&] { return finished || generation != seen; });
+                if (finished) {
+                    return;
+                }
+                seen = generation;
+                lock.unlock();
+                runWindow(partitions[p], windowEnd, limit);
+                lock.lock();
+                if (--running == 0) {
+                    windowDone.notify_one();
+                }
+            }
+        });
+    }
+
+    vector<PendingSend> sends;
+    Event* eventptr;
+    while (!stopped && (eventptr = peekEvent()) != nullptr &&
+           eventptr->evtime < until) {
+        if (eventptr->evtype == LINK_CHANGE) {
+            popEvent();
+            clocktime = eventptr->evtime;
+            processEvent(eventptr);
+            stats.eventsProcessed++;
+            delete eventptr;
+            continue;
+        }
+
+        {
+            lock_guard<mutex> lock{ windowMutex };
+            windowEnd = min(eventptr->evtime + LOOKAHEAD, until);
+            limit = linkEvents.empty() ? nullptr : linkEvents.front();
+            running = workers.size();
+            generation++;
+        }
+        windowStart.notify_all();
+        runWindow(partitions[0], windowEnd, limit);
+        {
+            unique_lock<mutex> lock{ windowMutex };
+            windowDone.wait(lock, [&] { return running == 0; });
+        }
+        SimulatorMetrics::Clock::time_point mergeStart;
+        if (metrics != nullptr) {
+            mergeStart = SimulatorMetrics::Clock::now();
+        }
+
+        // Schedule this window's sends in sequential order: by the order of
+        // the events that sent them, then by the order they were sent in.
+        sends.clear();
+        for (Partition& part : partitions) {
+            clocktime = max(clocktime, part.lasttime);
+            sends.insert(sends.end(), part.outbox.begin(), part.outbox.end());
+            part.outbox.clear();
+        }
+        sort(sends.begin(),
+             sends.end(),
+             [](PendingSend const& a, PendingSend const& b) {
+                 if (a.evtime != b.evtime) {
+                     return a.evtime < b.evtime;
+                 }
+                 if (a.evseq != b.evseq) {
+                     return a.evseq > b.evseq;
+                 }
+                 return a.index < b.index;
+             });
+        if (metrics != nullptr) {
+            // Scheduling the sends is measured by schedulePacket
+            metrics->scheduleTime(0,
+                                  SimulatorMetrics::Clock::now() - mergeStart);
+        }
+        double windowClock = clocktime;
+        for (PendingSend const& send : sends) {
+            clocktime = send.evtime;
+            if (send.pkt != nullptr) {
+                schedulePacket(send.pkt);
+            } else {
+                insertevent(send.timer);
+            }
+        }
+        clocktime = windowClock;
+        if (metrics != nullptr) {
+            metrics->queueDepth(pendingEvents());
+            if (metrics->due()) {
+                dumpMetrics(false);
+            }
+        }
+    }
+
+    {
+        lock_guard<mutex> lock{ windowMutex };
+        finished = true;
+    }
+    windowStart.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    for (Partition& part : partitions) {
+        stats.eventsProcessed += part.processed;
+        part.processed = 0;
+    }
+}
+
+/*
+ * Process the events of one partition that are due before `windowEnd`, and
+ * before the pending LINK_CHANGE event `limit` if there is one.
+ */
+void RouterSimulator::runWindow(Partition& part,
+                                double windowEnd,
+                                Event const* limit) {
+    activePartition = &part;
+    // Time outside the routers is spent on the event heap and outbox
+    int thread = static_cast<int>(&part - partitions.data());
+    SimulatorMetrics::Clock::time_point start;
+    SimulatorMetrics::Clock::duration measured{ 0 };
+    if (metrics != nullptr) {
+        start = SimulatorMetrics::Clock::now();
+        measured = metrics->measured(thread);
+    }
+    while (!part.events.empty()) {
+        Event* eventptr = part.events.front();
+        if (eventptr->evtime >= windowEnd ||
+            (limit != nullptr && eventAfter(eventptr, limit))) {
+            break;
+        }
+        pop_heap(part.events.begin(), part.events.end(), eventAfter);
+        part.events.pop_back();
+        part.lasttime = eventptr->evtime;
+        part.evseq = eventptr->seq;
+        part.sends = 0;
+        processEvent(eventptr);
+        part.processed++;
+        delete eventptr;
+    }
+    if (metrics != nullptr) {
+        metrics->scheduleTime(thread,
+                              SimulatorMetrics::Clock::now() - start -
+                                  (metrics->measured(thread) - measured));
+    }
+    activePartition = nullptr;
+}
+
 /* ******************** EVENT HANDLING ROUTINES ********************
  *         The next set of routines handle the event list          *
  * ****************************************************************/
 
+/*
+ * Event order: by time, and among events at the same time the most recently
+ * inserted one goes first, like in the original linked event list.
+ */
+bool RouterSimulator::eventAfter(Event const* a, Event const* b) {
+    if (a->evtime != b->evtime) {
+        return a->evtime > b->evtime;
+    }
+    return a->seq < b->seq;
+}
+
+int RouterSimulator::partitionOf(int node) const {
+    return nodePartitions[node];
+}
+
+/*
+ * The next event to simulate, or nullptr if there are none left
+ */
+Event* RouterSimulator::peekEvent() {
+    Event* next = linkEvents.empty() ? nullptr : linkEvents.front();
+    for (Partition const& part : partitions) {
+        if (!part.events.empty() &&
+            (next == nullptr || eventAfter(next, part.events.front()))) {
+            next = part.events.front();
+        }
+    }
+    return next;
+}
+
+/*
+ * Remove the next event to simulate from its heap and return it
+ */
+Event* RouterSimulator::popEvent() {
+    Event* next = peekEvent();
+    if (next == nullptr) {
+        return nullptr;
+    }
+    vector<Event*>& heap = next->evtype == LINK_CHANGE
+                               ? linkEvents
+                               : partitions[partitionOf(next->eventity)].events;
+    pop_heap(heap.begin(), heap.end(), eventAfter);
+    heap.pop_back();
+    return next;
+}
+
 void RouterSimulator::insertevent(Event* p) {
-    if (RouterSimulator::TRACE > 3) {
+    if (TRACE > 3) {
         myGUI.println("            INSERTEVENT: time is " +
                       to_string(clocktime));
         myGUI.println("            INSERTEVENT: future time will be " +
                       to_string(p->evtime));
     }
-    // q points to header of list in which p struct inserted
-    Event* q = evlist;
-    Event* qold = nullptr;
-    if (q == nullptr) {
-        // list is empty
-        evlist = p;
-        p->next = nullptr;
-        p->prev = nullptr;
-    } else {
-        for (qold = q; q != nullptr && p->evtime > q->evtime; q = q->next) {
-            qold = q;
-        }
-        if (q == nullptr) {
-            // end of list
-            qold->next = p;
-            p->prev = qold;
-            p->next = nullptr;
-        } else if (q == evlist) {
-            // front of list
-            p->next = evlist;
-            p->prev = nullptr;
-            p->next->prev = p;
-            evlist = p;
-        } else {
-            // middle of list
-            p->next = q;
-            p->prev = q->prev;
-            q->prev->next = p;
-            q->prev = p;
-        }
+    p->seq = nextSeq++;
+    pushEvent(p);
+}
+
+/*
+ * Add an event that already has its seq to the heap it belongs in
+ */
+void RouterSimulator::pushEvent(Event* p) {
+    vector<Event*>& heap = p->evtype == LINK_CHANGE
+                               ? linkEvents
+                               : partitions[partitionOf(p->eventity)].events;
+    heap.push_back(p);
+    push_heap(heap.begin(), heap.end(), eventAfter);
+}
+
+/*
+ * The random stream of the link from `from` to `to`, which only depends on
+ * SEED and the link, so delays do not depend on the order links send in
+ */
+LinkRandom& RouterSimulator::linkStream(int from, int to) {
+    auto& streams = linkRandom[from];
+    auto it = lower_bound(
+        streams.begin(), streams.end(), to, [](auto& stream, int dest) {
+            return stream.first < dest;
+        });
+    if (it == streams.end() || it->first != to) {
+        it = streams.insert(it, { to, LinkRandom{ SEED, from, to } });
     }
+    return it->second;
 }
 
 /************************** TOLAYER2 ***************************/
-void RouterSimulator::toLayer2(RouterPacket& packet) {
+void RouterSimulator::toLayer2(RouterPacket&& packet) {
+    // take over the packet student just gave me, the medium now owns it
+    RouterPacket* mypktptr = new RouterPacket{ std::move(packet) };
+    if (activePartition != nullptr) {
+        // Sent during a parallel window, schedule it when the window is done
+        Partition& part = *activePartition;
+        part.outbox.push_back(
+            { part.lasttime, part.evseq, part.sends++, mypktptr, nullptr });
+        return;
+    }
+    schedulePacket(mypktptr);
+}
+
+/*
+ * Have timerExpired(`timer`) called on `node` after `delay` time units, which
+ * must be at least LOOKAHEAD
+ */
+void RouterSimulator::setTimer(int node, double delay, int timer) {
+    Event* evptr = new Event{};
+    evptr->evtime = getClockTime() + delay;
+    evptr->evtype = TIMER;
+    evptr->eventity = node;
+    evptr->rtpktptr = nullptr;
+    evptr->dest = timer;
+    if (activePartition != nullptr) {
+        Partition& part = *activePartition;
+        part.outbox.push_back(
+            { part.lasttime, part.evseq, part.sends++, nullptr, evptr });
+        return;
+    }
+    insertevent(evptr);
+}
+
+/*
+ * Check a packet that was sent and schedule its arrival at the other side
+ */
+void RouterSimulator::schedulePacket(RouterPacket* mypktptr) {
+    RouterPacket const& packet = *mypktptr;
     // be nice: check if source and destination id's are reasonable
     if (packet.sourceid < 0 ||
-        packet.sourceid > RouterSimulator::NUM_NODES - 1) {
+        packet.sourceid > NUM_NODES - 1) {
 
         myGUI.println(
             "WARN: illegal source id in your packet, ignoring packet!");
+        delete mypktptr;
         return;
     }
-    if (packet.destid < 0 || packet.destid > RouterSimulator::NUM_NODES - 1) {
+    if (packet.destid < 0 || packet.destid > NUM_NODES - 1) {
         myGUI.println("WARN: illegal dest id in your packet, ignoring packet!");
+        delete mypktptr;
         return;
     }
     if (packet.sourceid == packet.destid) {
         myGUI.println(
             "WARN: source and destination id's the same, ignoring packet");
+        delete mypktptr;
         return;
     }
-    if (connectcosts[packet.sourceid][packet.destid] == INFINITY) {
+    if (topology.cost(packet.sourceid, packet.destid) == -1) {
         myGUI.println(
             "WARN: source and destination not connected, ignoring packet");
+        delete mypktptr;
         return;
     }
 
-    // make a copy of the packet student just gave me since may
-    // be modified after we return back
-    // (it may also be deallocated from the stack, depending on
-    // how the student has created the object instance)
-    RouterPacket* mypktptr = packet.clone();
-    if (RouterSimulator::TRACE > 2) {
+    SimulatorMetrics::Clock::time_point start;
+    if (metrics != nullptr) {
+        start = SimulatorMetrics::Clock::now();
+        metrics->sent(mypktptr->sourceid, mypktptr->destid);
+    }
+    stats.packetsSent++;
+    stats.entriesSent += mypktptr->numEntries();
+    stats.bytesSent += mypktptr->size();
+    if (TRACE > 2) {
         myGUI.print("    TOLAYER2: source: " + to_string(mypktptr->sourceid) +
-                    " dest: " + to_string(mypktptr->destid) +
-                    "             costs:");
-        for (int i = 0; i < RouterSimulator::NUM_NODES; i++) {
-            myGUI.print(to_string(mypktptr->mincost[i]) + " ");
+                    " dest: " + to_string(mypktptr->destid) + " entries: " +
+                    to_string(mypktptr->numEntries()) +
+                    " bytes: " + to_string(mypktptr->size()) + " costs:");
+        for (int cost : mypktptr->mincost) {
+            myGUI.print(to_string(cost) + " ");
+        }
+        for (auto const& [dest, cost] : mypktptr->changes) {
+            myGUI.print(to_string(dest) + ":" + to_string(cost) + " ");
         }
         myGUI.println();
     }
 
+    double arrival = 0.0;
+    LinkRandom& random = linkStream(mypktptr->sourceid, mypktptr->destid);
+    if (linkModel != nullptr) {
+        LinkModel::Outcome outcome = linkModel->transmit(mypktptr->sourceid,
+                                                         mypktptr->destid,
+                                                         mypktptr->size(),
+                                                         clocktime,
+                                                         random,
+                                                         arrival);
+        if (outcome != LinkModel::DELIVERED) {
+            dropPacket(mypktptr, outcome);
+            if (metrics != nullptr) {
+                metrics->scheduleTime(0,
+                                      SimulatorMetrics::Clock::now() - start);
+            }
+            return;
+        }
+    } else {
+        // medium can not reorder, so make sure packet arrives between 1
+        // and 10 time units after the latest arrival time of packets
+        // currently in the medium on their way to the destination
+        double lastime = max(clocktime, lastArrival[mypktptr->destid]);
+        arrival = lastime + 9.0f * random.nextDouble() + 1.0f;
+        lastArrival[mypktptr->destid] = arrival;
+    }
+
     // create future event for arrival of packet at the other side
     Event* evptr = new Event{};
     // packet will pop out from layer3
@@ -335,31 +1056,175 @@ void RouterSimulator::toLayer2(RouterPacket& packet) {
     // save ptr to my copy of packet
     evptr->rtpktptr = mypktptr;
 
-    // finally, compute the arrival time of packet at the other end.
-    // medium can not reorder, so make sure packet arrives between 1
-    // and 10 time units after the latest arrival time of packets
-    // currently in the medium on their way to the destination
-    double lastime = clocktime;
-    for (Event* q = evlist; q != nullptr; q = q->next) {
-        if (q->evtype == FROM_LAYER2 && q->eventity == evptr->eventity) {
-            lastime = q->evtime;
-        }
+    // finally, the arrival time of packet at the other end
+    evptr->evtime = arrival;
+    if (traceWriter != nullptr) {
+        traceSend(evptr);
     }
-    evptr->evtime =
-        lastime + 9.0f * (static_cast<double>(rand()) / RAND_MAX) + 1.0f;
 
-    if (RouterSimulator::TRACE > 2) {
+    if (TRACE > 2) {
         myGUI.println("    TOLAYER2: scheduling arrival on other side");
-        insertevent(evptr);
     }
+    insertevent(evptr);
+    if (metrics != nullptr) {
+        metrics->scheduleTime(0, SimulatorMetrics::Clock::now() - start);
+    }
+}
+
+/*
+ * A packet the LinkModel did not deliver because of `outcome`
+ */
+void RouterSimulator::dropPacket(RouterPacket* mypktptr,
+                                 LinkModel::Outcome outcome) {
+    if (outcome == LinkModel::LOST) {
+        stats.packetsLost++;
+    } else {
+        stats.packetsDropped++;
+    }
+    if (TRACE > 2) {
+        myGUI.println(outcome == LinkModel::LOST
+                          ? "    TOLAYER2: packet lost on the link"
+                          : "    TOLAYER2: link queue full, dropping packet");
+    }
+    if (traceWriter != nullptr) {
+        traceDrop(*mypktptr, outcome);
+    }
+    delete mypktptr;
+}
+
+/*
+ * How the contents of `pkt` are laid out in the trace
+ */
+static TraceFormat traceFormat(RouterPacket const& pkt) {
+    if (pkt.isFull()) {
+        return TRACE_COSTS;
+    }
+    return pkt.isLinkState() ? TRACE_LSA : TRACE_CHANGES;
+}
+
+/*
+ * Record an event that is about to be simulated in the binary trace
+ */
+void RouterSimulator::traceEvent(Event* eventptr) {
+    TraceRecord record{};
+    record.time = eventptr->evtime;
+    if (eventptr->evtype == LINK_CHANGE) {
+        record.type = TRACE_LINK_CHANGE;
+        record.src = eventptr->eventity;
+        record.dst = eventptr->dest;
+        record.entries = eventptr->cost;
+    } else if (eventptr->evtype == TIMER) {
+        record.type = TRACE_TIMER;
+        record.src = eventptr->eventity;
+        record.dst = eventptr->eventity;
+        record.entries = eventptr->dest;
+    } else {
+        RouterPacket const& pkt = *eventptr->rtpktptr;
+        // The contents were written when the packet was sent, unless that
+        // was before the trace started, e.g. in a restored simulation
+        if (eventptr->tracepayload == 0) {
+            eventptr->tracepayload = tracePayload(pkt);
+        }
+        record.payload = eventptr->tracepayload;
+        record.type = TRACE_RECV;
+        record.src = pkt.sourceid;
+        record.dst = pkt.destid;
+        record.entries = static_cast<int>(pkt.numEntries());
+        record.format = traceFormat(pkt);
+        record.bytes = static_cast<int>(pkt.size());
+    }
+    traceWriter->record(record);
 }
 
-void RouterSimulator::initialize(int argc, char* argv[]) {
+/*
+ * Record a packet that was just scheduled to arrive by `evptr`
+ */
+void RouterSimulator::traceSend(Event* evptr) {
+    RouterPacket const& pkt = *evptr->rtpktptr;
+    evptr->tracepayload = tracePayload(pkt);
+    TraceRecord record{};
+    record.time = clocktime;
+    record.arrival = evptr->evtime;
+    record.payload = evptr->tracepayload;
+    record.type = TRACE_SEND;
+    record.src = pkt.sourceid;
+    record.dst = pkt.destid;
+    record.entries = static_cast<int>(pkt.numEntries());
+    record.format = traceFormat(pkt);
+    record.bytes = static_cast<int>(pkt.size());
+    traceWriter->record(record);
+}
+
+/*
+ * Record a packet that was lost or dropped by the LinkModel
+ */
+void RouterSimulator::traceDrop(RouterPacket const& pkt,
+                                LinkModel::Outcome outcome) {
+    TraceRecord record{};
+    record.time = clocktime;
+    record.type = TRACE_DROP;
+    record.src = pkt.sourceid;
+    record.dst = pkt.destid;
+    record.entries = outcome == LinkModel::LOST ? TRACE_LOST : TRACE_DROPPED;
+    record.bytes = static_cast<int>(pkt.size());
+    traceWriter->record(record);
+}
+
+/*
+ * Copy the contents of `pkt` to the trace and return their offset
+ */
+uint64_t RouterSimulator::tracePayload(RouterPacket const& pkt) {
+    if (pkt.isFull()) {
+        return traceWriter->payload(pkt.mincost.data(),
+                                    pkt.mincost.size() * sizeof(int));
+    }
+    size_t bytes = pkt.changes.size() * sizeof(pkt.changes[0]);
+    if (!pkt.isLinkState()) {
+        return traceWriter->payload(pkt.changes.data(), bytes);
+    }
+    int header[] = { pkt.origin, pkt.sequence };
+    uint64_t offset = traceWriter->payload(header, sizeof(header));
+    traceWriter->payload(pkt.changes.data(), bytes);
+    return offset;
+}
+
+/*
+ * Read the configuration of a simulation from the command line
+ */
+SimulatorConfig RouterSimulator::initialize(int argc, char* argv[]) {
+    SimulatorConfig config;
     string inputInfo = "-c, --change <LINKCHANGE (bool)> "
                        "-n, --nodes <NODES (int)> "
                        "-p, --poisonreverse <POISONREVERSE (bool)> "
                        "-s, --seed <SEED (long)> "
-                       "-t, --trace <TRACE (int)>"
+                       "-t, --trace <TRACE (int)> "
+                       "-j, --threads <THREADS (int)> "
+                       "-u, --until <UNTIL (double)> "
+                       "-o, --save <SAVEFILE (path)> "
+                       "-r, --restore <RESTOREFILE (path)> "
+                       "-P, --protocol <PROTOCOL (dv|ls)> "
+                       "-f, --scenario <SCENARIOFILE (path)> "
+                       "-k, --churn <CHURNRATE (double)> "
+                       "-K, --churn-until <CHURNUNTIL (double)> "
+                       "-T, --tracefile <TRACEFILE (path)> "
+                       "-R, --report <full|changes> "
+                       "-I, --report-interval <REPORTINTERVAL (double)> "
+                       "-d, --update-delay <UPDATEDELAY (double)> "
+                       "-H, --holddown <HOLDDOWN (double)> "
+                       "-m, --min-interval <MININTERVAL (double)> "
+                       "-L, --gui-lines <GUILINES (int)> "
+                       "-M, --metrics <METRICSFILE (path)> "
+                       "-W, --metrics-interval <METRICSINTERVAL (double)> "
+                       "-l, --latency <LATENCY (double)> "
+                       "-b, --bandwidth <BANDWIDTH (double)> "
+                       "-Q, --queue <QUEUELIMIT (int)> "
+                       "-x, --loss <LOSS (double)> "
+                       "-F, --linkfile <LINKFILE (path)> "
+                       "-e, --refresh <REFRESH (double)> "
+                       "-E, --refresh-until <REFRESHUNTIL (double)> "
+                       "-z, --horizon <lab|split|poison> "
+                       "-i, --infinity <INFINITY (int)> "
+                       "-V, --path-vector <PATHVECTOR (bool)>"
                        "\n";
 
     option longOptions[] = {
@@ -368,6 +1233,33 @@ void RouterSimulator::initialize(int argc, char* argv[]) {
         { "poisonreverse", required_argument, nullptr, 'p' },
         { "seed", required_argument, nullptr, 's' },
         { "trace", required_argument, nullptr, 't' },
+        { "threads", required_argument, nullptr, 'j' },
+        { "until", required_argument, nullptr, 'u' },
+        { "save", required_argument, nullptr, 'o' },
+        { "restore", required_argument, nullptr, 'r' },
+        { "protocol", required_argument, nullptr, 'P' },
+        { "scenario", required_argument, nullptr, 'f' },
+        { "churn", required_argument, nullptr, 'k' },
+        { "churn-until", required_argument, nullptr, 'K' },
+        { "tracefile", required_argument, nullptr, 'T' },
+        { "report", required_argument, nullptr, 'R' },
+        { "report-interval", required_argument, nullptr, 'I' },
+        { "update-delay", required_argument, nullptr, 'd' },
+        { "holddown", required_argument, nullptr, 'H' },
+        { "min-interval", required_argument, nullptr, 'm' },
+        { "gui-lines", required_argument, nullptr, 'L' },
+        { "metrics", required_argument, nullptr, 'M' },
+        { "metrics-interval", required_argument, nullptr, 'W' },
+        { "latency", required_argument, nullptr, 'l' },
+        { "bandwidth", required_argument, nullptr, 'b' },
+        { "queue", required_argument, nullptr, 'Q' },
+        { "loss", required_argument, nullptr, 'x' },
+        { "linkfile", required_argument, nullptr, 'F' },
+        { "refresh", required_argument, nullptr, 'e' },
+        { "refresh-until", required_argument, nullptr, 'E' },
+        { "horizon", required_argument, nullptr, 'z' },
+        { "infinity", required_argument, nullptr, 'i' },
+        { "path-vector", required_argument, nullptr, 'V' },
         { nullptr, 0, nullptr, 0 }
     };
 
@@ -381,31 +1273,147 @@ void RouterSimulator::initialize(int argc, char* argv[]) {
 
     int opt;
     try {
-        while ((opt = getopt_long(
-                    argc, argv, "c:n:p:s:t:", longOptions, nullptr)) != -1) {
+        while ((opt = getopt_long(argc,
+                                  argv,
+                                  "c:n:p:s:t:j:u:o:r:P:f:k:K:T:R:I:"
+                                  "d:H:m:L:M:W:l:b:Q:x:F:e:E:z:i:V:",
+                                  longOptions,
+                                  nullptr)) != -1) {
             switch (opt) {
             case 'c': {
                 if (opt_is(affirmative)) {
-                    RouterSimulator::LINKCHANGES = true;
+                    config.LINKCHANGES = true;
                 } else if (opt_is(negative)) {
-                    RouterSimulator::LINKCHANGES = false;
+                    config.LINKCHANGES = false;
                 }
             } break;
             case 'n': {
-                RouterSimulator::NUM_NODES = stoi(optarg);
+                config.NUM_NODES = stoi(optarg);
             } break;
             case 'p': {
                 if (opt_is(affirmative)) {
-                    RouterSimulator::POISONREVERSE = true;
+                    config.POISONREVERSE = true;
                 } else if (opt_is(negative)) {
-                    RouterSimulator::POISONREVERSE = false;
+                    config.POISONREVERSE = false;
                 }
             } break;
             case 's': {
-                RouterSimulator::SEED = stol(optarg);
+                config.SEED = stol(optarg);
             } break;
             case 't': {
-                RouterSimulator::TRACE = stoi(optarg);
+                config.TRACE = stoi(optarg);
+            } break;
+            case 'j': {
+                config.THREADS = stoi(optarg);
+            } break;
+            case 'u': {
+                config.UNTIL = stod(optarg);
+            } break;
+            case 'o': {
+                config.SAVEFILE = optarg;
+            } break;
+            case 'r': {
+                config.RESTOREFILE = optarg;
+            } break;
+            case 'f': {
+                config.SCENARIOFILE = optarg;
+            } break;
+            case 'k': {
+                config.CHURNRATE = stod(optarg);
+            } break;
+            case 'K': {
+                config.CHURNUNTIL = stod(optarg);
+            } break;
+            case 'T': {
+                config.TRACEFILE = optarg;
+            } break;
+            case 'R': {
+                if (string{ optarg } == "changes") {
+                    config.REPORTCHANGES = true;
+                } else if (string{ optarg } == "full") {
+                    config.REPORTCHANGES = false;
+                } else {
+                    cerr << argv[0] << inputInfo;
+                    exit(EXIT_FAILURE);
+                }
+            } break;
+            case 'I': {
+                config.REPORTINTERVAL = stod(optarg);
+            } break;
+            case 'd': {
+                config.UPDATEDELAY = stod(optarg);
+            } break;
+            case 'H': {
+                config.HOLDDOWN = stod(optarg);
+            } break;
+            case 'm': {
+                config.MININTERVAL = stod(optarg);
+            } break;
+            case 'L': {
+                config.GUILINES = stoi(optarg);
+                if (config.GUILINES < 1) {
+                    cerr << argv[0] << inputInfo;
+                    exit(EXIT_FAILURE);
+                }
+            } break;
+            case 'M': {
+                config.METRICSFILE = optarg;
+            } break;
+            case 'W': {
+                config.METRICSINTERVAL = stod(optarg);
+            } break;
+            case 'l': {
+                config.LATENCY = stod(optarg);
+            } break;
+            case 'b': {
+                config.BANDWIDTH = stod(optarg);
+            } break;
+            case 'Q': {
+                config.QUEUELIMIT = stoi(optarg);
+            } break;
+            case 'x': {
+                config.LOSS = stod(optarg);
+            } break;
+            case 'F': {
+                config.LINKFILE = optarg;
+            } break;
+            case 'e': {
+                config.REFRESH = stod(optarg);
+            } break;
+            case 'E': {
+                config.REFRESHUNTIL = stod(optarg);
+            } break;
+            case 'z': {
+                if (string{ optarg } == "lab") {
+                    config.HORIZON = Horizon::Lab;
+                } else if (string{ optarg } == "split") {
+                    config.HORIZON = Horizon::Split;
+                } else if (string{ optarg } == "poison") {
+                    config.HORIZON = Horizon::Poison;
+                } else {
+                    cerr << argv[0] << inputInfo;
+                    exit(EXIT_FAILURE);
+                }
+            } break;
+            case 'i': {
+                config.INFINITY = stoi(optarg);
+            } break;
+            case 'V': {
+                if (opt_is(affirmative)) {
+                    config.PATHVECTOR = true;
+                } else if (opt_is(negative)) {
+                    config.PATHVECTOR = false;
+                }
+            } break;
+            case 'P': {
+                if (string{ optarg } == "ls") {
+                    config.PROTOCOL = Protocol::LinkState;
+                } else if (string{ optarg } == "dv") {
+                    config.PROTOCOL = Protocol::DistanceVector;
+                } else {
+                    cerr << argv[0] << inputInfo;
+                    exit(EXIT_FAILURE);
+                }
             } break;
             default: {
                 cerr << argv[0] << inputInfo;
@@ -417,8 +1425,144 @@ void RouterSimulator::initialize(int argc, char* argv[]) {
         cerr << argv[0] << inputInfo << endl;
         exit(2);
     }
+    return config;
 }
 
+#ifndef HEADLESS
 int main(int argc, char* argv[]) {
     RouterSimulator::main(argc, argv);
 }
+#endif
+
+/* ******************** SNAPSHOTS ********************************
+ * A snapshot holds everything a simulation needs to continue: the settings
+ * that affect routing, the topology, the clock and event counter, the
+ * statistics, the medium (latest arrivals, the link model with its queues and
+ * the state of every link's random stream), the tables of every node, the
+ * pending events with their packets, and the random churn. Restoring it and
+ * running on gives the same events as never having stopped.
+ * ****************************************************************/
+
+const uint32_t SNAPSHOT_MAGIC = 0x4D495352; /* "RSIM" */
+const uint32_t SNAPSHOT_VERSION = 7;
+
+void RouterSimulator::saveSnapshot(string const& path) const {
+    SnapshotWriter snapshot;
+    snapshot.put(SNAPSHOT_MAGIC);
+    snapshot.put(SNAPSHOT_VERSION);
+    snapshot.put<uint32_t>(sizeof(Cost));
+    snapshot.put(PROTOCOL);
+    snapshot.put(POISONREVERSE);
+    snapshot.put(SEED);
+    snapshot.put(INFINITY);
+    snapshot.put(HORIZON);
+    snapshot.put(PATHVECTOR);
+    snapshot.put(UPDATEDELAY);
+    snapshot.put(HOLDDOWN);
+    snapshot.put(MININTERVAL);
+    snapshot.put(REFRESH);
+    snapshot.put(REFRESHUNTIL);
+    snapshot.put(linkModel != nullptr);
+    if (linkModel != nullptr) {
+        linkModel->save(snapshot);
+    }
+    topology.save(snapshot);
+
+    snapshot.put(clocktime);
+    snapshot.put(nextSeq);
+    snapshot.put(stats);
+    snapshot.putVector(lastArrival);
+    for (auto const& streams : linkRandom) {
+        vector<pair<int, uint64_t>> drawn;
+        for (auto const& [to, stream] : streams) {
+            drawn.emplace_back(to, stream.drawn());
+        }
+        snapshot.putVector(drawn);
+    }
+
+    for (auto const& node : nodes) {
+        node->save(snapshot);
+    }
+
+    // Streams are not saved with the events, the churn is saved after them
+    vector<Event*> pending;
+    for (Event* evptr : linkEvents) {
+        if (none_of(linkStreams.begin(),
+                    linkStreams.end(),
+                    [&](LinkStream const& stream) {
+                        return stream.pending == evptr;
+                    })) {
+            pending.push_back(evptr);
+        }
+    }
+    for (Partition const& part : partitions) {
+        pending.insert(pending.end(), part.events.begin(), part.events.end());
+    }
+    snapshot.put<uint64_t>(pending.size());
+    for (Event const* evptr : pending) {
+        snapshot.put(evptr->evtime);
+        snapshot.put(evptr->evtype);
+        snapshot.put(evptr->eventity);
+        snapshot.put(evptr->dest);
+        snapshot.put(evptr->cost);
+        snapshot.put(evptr->seq);
+        if (evptr->evtype == FROM_LAYER2) {
+            RouterPacket const& pkt = *evptr->rtpktptr;
+            snapshot.put(pkt.sourceid);
+            snapshot.put(pkt.destid);
+            snapshot.putVector(pkt.mincost);
+            snapshot.putVector(pkt.changes);
+            snapshot.put(pkt.complete);
+            snapshot.put<uint64_t>(pkt.paths.size());
+            for (vector<int> const& path : pkt.paths) {
+                snapshot.putVector(path);
+            }
+            snapshot.put(pkt.origin);
+            snapshot.put(pkt.sequence);
+        }
+    }
+
+    snapshot.put(churn != nullptr);
+    for (LinkStream const& stream : linkStreams) {
+        if (stream.source.get() == churn) {
+            churn->save(snapshot);
+            snapshot.put(stream.pending != nullptr);
+            if (stream.pending != nullptr) {
+                snapshot.put(LinkChange{ stream.pending->evtime,
+                                         stream.pending->eventity,
+                                         stream.pending->dest,
+                                         stream.pending->cost });
+            }
+        }
+    }
+    snapshot.save(path);
+}
+
+/*
+ * Check the header of a snapshot and take the settings it was saved with
+ */
+SimulatorConfig RouterSimulator::snapshotConfig(SimulatorConfig config,
+                                                SnapshotReader& snapshot) {
+    if (snapshot.get<uint32_t>() != SNAPSHOT_MAGIC ||
+        snapshot.get<uint32_t>() != SNAPSHOT_VERSION) {
+        cerr << "Panic: not a snapshot of this simulator version" << endl;
+        exit(1);
+    }
+    // The tables of the nodes are saved as they are
+    if (snapshot.get<uint32_t>() != sizeof(Cost)) {
+        cerr << "Panic: snapshot was saved with another COST_BITS" << endl;
+        exit(1);
+    }
+    config.PROTOCOL = snapshot.get<Protocol>();
+    config.POISONREVERSE = snapshot.get<bool>();
+    config.SEED = snapshot.get<long>();
+    config.INFINITY = snapshot.get<int>();
+    config.HORIZON = snapshot.get<Horizon>();
+    config.PATHVECTOR = snapshot.get<bool>();
+    config.UPDATEDELAY = snapshot.get<double>();
+    config.HOLDDOWN = snapshot.get<double>();
+    config.MININTERVAL = snapshot.get<double>();
+    config.REFRESH = snapshot.get<double>();
+    config.REFRESHUNTIL = snapshot.get<double>();
+    return config;
+}
@@ -0,0 +1,153 @@
+#include "Scenario.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Open a scenario for the network `topology`, where `infinity` is the cost
+ * of a failed link
+ */
+ScenarioFile::ScenarioFile(string const& path, Topology topology, int infinity)
+    : path{ path }, file{ path }, upCosts{ std::move(topology) },
+      infinity{ infinity } {
+    if (!file) {
+        cerr << "Panic: could not open scenario " << path << endl;
+        exit(1);
+    }
+}
+
+/*
+ * Read lines up to the next link change
+ */
+bool ScenarioFile::next(LinkChange& change) {
+    string line;
+    while (getline(file, line)) {
+        lineNumber++;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#') {
+            continue;
+        }
+
+        istringstream fields{ line };
+        string action;
+        fields >> change.time >> action >> change.from >> change.to;
+        int numNodes = upCosts.numNodes();
+        bool valid = !fields.fail() && change.time >= lastTime &&
+                     change.from >= 0 && change.from < numNodes &&
+                     change.to >= 0 && change.to < numNodes &&
+                     change.from != change.to;
+        if (valid && action == "change") {
+            valid = static_cast<bool>(fields >> change.cost) &&
+                    change.cost >= 0 && change.cost <= infinity;
+        } else if (valid && action == "fail") {
+            change.cost = infinity;
+        } else if (valid && action == "recover") {
+            if (!(fields >> change.cost)) {
+                change.cost = upCosts.cost(change.from, change.to);
+            }
+            valid = change.cost >= 0 && change.cost < infinity;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            cerr << "Panic: invalid link change at " << path << ':'
+                 << lineNumber << endl;
+            exit(1);
+        }
+
+        if (change.cost < infinity) {
+            upCosts.setCost(change.from, change.to, change.cost);
+        }
+        lastTime = change.time;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Churn over the links of `topology` starting at `begin`, drawing from a
+ * random stream keyed by `seed`
+ */
+RandomChurn::RandomChurn(Topology const& topology,
+                         double rate,
+                         double begin,
+                         double until,
+                         int maxCost,
+                         int infinity,
+                         long seed)
+    : random{ seed, -1, -1 }, rate{ rate }, time{ begin }, until{ until },
+      maxCost{ maxCost }, infinity{ infinity } {
+    for (int from = 0; from < topology.numNodes(); from++) {
+        for (auto const& [to, cost] : topology.links(from)) {
+            if (from < to) {
+                links.emplace_back(from, to);
+                costs.push_back(cost);
+            }
+        }
+    }
+    upCosts = costs;
+}
+
+/*
+ * Continue churn saved with save, drawing from the stream keyed by `seed`
+ */
+RandomChurn::RandomChurn(SnapshotReader& snapshot, long seed)
+    : random{ seed, -1, -1 } {
+    links = snapshot.getVector<pair<int, int>>();
+    costs = snapshot.getVector<int>();
+    upCosts = snapshot.getVector<int>();
+    random.setDrawn(snapshot.get<uint64_t>());
+    rate = snapshot.get<double>();
+    time = snapshot.get<double>();
+    until = snapshot.get<double>();
+    maxCost = snapshot.get<int>();
+    infinity = snapshot.get<int>();
+}
+
+void RandomChurn::save(SnapshotWriter& snapshot) const {
+    snapshot.putVector(links);
+    snapshot.putVector(costs);
+    snapshot.putVector(upCosts);
+    snapshot.put(random.drawn());
+    snapshot.put(rate);
+    snapshot.put(time);
+    snapshot.put(until);
+    snapshot.put(maxCost);
+    snapshot.put(infinity);
+}
+
+bool RandomChurn::next(LinkChange& change) {
+    if (links.empty() || rate <= 0.0) {
+        return false;
+    }
+    time += -log(1.0 - random.nextDouble()) / rate;
+    if (time >= until) {
+        return false;
+    }
+
+    size_t link = min(links.size() - 1,
+                      static_cast<size_t>(random.nextDouble() * links.size()));
+    int cost;
+    if (costs[link] >= infinity) {
+        cost = upCosts[link];
+    } else if (random.nextDouble() < 0.5) {
+        upCosts[link] = costs[link];
+        cost = infinity;
+    } else {
+        cost = 1 + min(maxCost - 1,
+                       static_cast<int>(random.nextDouble() * maxCost));
+    }
+    costs[link] = cost;
+    change = { time, links[link].first, links[link].second, cost };
+    return true;
+}
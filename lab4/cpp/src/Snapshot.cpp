@@ -0,0 +1,71 @@
+#include "Snapshot.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * Write everything put so far to `path`, replacing the file
+ */
+void SnapshotWriter::save(string const& path) const {
+    ofstream file{ path, ios::binary | ios::trunc };
+    file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    if (!file) {
+        cerr << "Panic: could not write snapshot " << path << endl;
+        exit(1);
+    }
+}
+
+/*
+ * Map the snapshot at `path` read-only into memory
+ */
+SnapshotReader::SnapshotReader(string const& path)
+    : path{ path }, data{ nullptr }, size{ 0 } {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        cerr << "Panic: could not open snapshot " << path << endl;
+        exit(1);
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            cerr << "Panic: could not map snapshot " << path << endl;
+            exit(1);
+        }
+        data = static_cast<char const*>(mapped);
+    }
+    close(fd);
+}
+
+SnapshotReader::~SnapshotReader() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+/*
+ * Advance past the next `bytes` bytes and return where they start
+ */
+char const* SnapshotReader::take(size_t bytes) {
+    if (bytes > size - offset) {
+        corrupt();
+    }
+    char const* start = data + offset;
+    offset += bytes;
+    return start;
+}
+
+void SnapshotReader::corrupt() const {
+    cerr << "Panic: snapshot " << path << " is truncated or corrupt" << endl;
+    exit(1);
+}
@@ -0,0 +1,216 @@
+#include "Topology.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Create a topology of `numNodes` nodes without any links
+ */
+Topology::Topology(int numNodes) : adjacency(numNodes) {}
+
+/*
+ * The topologies from the lab template, for 3, 4 or 5 nodes.
+ * Links that the template gives an infinite cost are left out.
+ */
+Topology Topology::builtin(int numNodes) {
+    Topology topology{ numNodes };
+    switch (numNodes) {
+    case 3: {
+        topology.setCost(0, 1, 4);
+        topology.setCost(0, 2, 1);
+        topology.setCost(1, 2, 50);
+    } break;
+    case 4: {
+        topology.setCost(0, 1, 1);
+        topology.setCost(0, 2, 3);
+        topology.setCost(0, 3, 7);
+        topology.setCost(1, 2, 1);
+        topology.setCost(2, 3, 2);
+    } break;
+    case 5: {
+        topology.setCost(0, 1, 1);
+        topology.setCost(0, 2, 3);
+        topology.setCost(0, 3, 7);
+        topology.setCost(0, 4, 1);
+        topology.setCost(1, 2, 1);
+        topology.setCost(1, 4, 1);
+        topology.setCost(2, 3, 2);
+        topology.setCost(2, 4, 4);
+    } break;
+    default: {
+        cerr << "Unsupported number of nodes." << endl;
+        exit(0);
+    };
+    }
+    return topology;
+}
+
+/*
+ * Generate a connected topology with an average node degree of about
+ * `degree` and link costs in [1, maxCost].
+ * A random tree keeps it connected, then random extra links are added.
+ */
+Topology Topology::random(int numNodes,
+                          int degree,
+                          int maxCost,
+                          unsigned long seed) {
+    Topology topology{ numNodes };
+    mt19937_64 rng{ seed };
+    uniform_int_distribution<int> randomCost{ 1, maxCost };
+    for (int node = 1; node < numNodes; node++) {
+        uniform_int_distribution<int> randomParent{ 0, node - 1 };
+        topology.setCost(node, randomParent(rng), randomCost(rng));
+    }
+
+    size_t wanted = static_cast<size_t>(numNodes) * degree / 2;
+    size_t maxLinks = static_cast<size_t>(numNodes) * (numNodes - 1) / 2;
+    wanted = min(wanted, maxLinks);
+    uniform_int_distribution<int> randomNode{ 0, numNodes - 1 };
+    for (size_t links = numNodes - 1; links < wanted;) {
+        int a = randomNode(rng);
+        int b = randomNode(rng);
+        if (a != b && topology.cost(a, b) == -1) {
+            topology.setCost(a, b, randomCost(rng));
+            links++;
+        }
+    }
+    return topology;
+}
+
+int Topology::numNodes() const {
+    return static_cast<int>(adjacency.size());
+}
+
+size_t Topology::numLinks() const {
+    size_t ends = 0;
+    for (auto const& links : adjacency) {
+        ends += links.size();
+    }
+    return ends / 2;
+}
+
+/*
+ * Cost of the link between `a` and `b`, or -1 if they are not linked
+ */
+int Topology::cost(int a, int b) const {
+    auto const& links = adjacency[a];
+    auto it = lower_bound(
+        links.begin(), links.end(), make_pair(b, 0), [](auto& x, auto& y) {
+            return x.first < y.first;
+        });
+    if (it == links.end() || it->first != b) {
+        return -1;
+    }
+    return it->second;
+}
+
+/*
+ * Set the cost of the link between `a` and `b` in both directions, adding the
+ * link if it does not exist yet
+ */
+void Topology::setCost(int a, int b, int cost) {
+    for (auto [from, to] : { make_pair(a, b), make_pair(b, a) }) {
+        auto& links = adjacency[from];
+        auto it = lower_bound(
+            links.begin(), links.end(), make_pair(to, 0), [](auto& x, auto& y) {
+                return x.first < y.first;
+            });
+        if (it != links.end() && it->first == to) {
+            it->second = cost;
+        } else {
+            links.insert(it, { to, cost });
+        }
+    }
+}
+
+/*
+ * The (neighbor, cost) pairs of `node`, sorted by neighbor
+ */
+vector<pair<int, int>> const& Topology::links(int node) const {
+    return adjacency[node];
+}
+
+/*
+ * Split the nodes into `parts` ranges of consecutive IDs, and return the
+ * partition of every node. Every node weighs one plus its degree, about the
+ * events it gets, and the ranges weigh about the same. After a Renumbering
+ * most links are inside a range, so most packets stay within a partition and
+ * the tables of its nodes in the cache of the thread simulating it.
+ */
+vector<int> Topology::partition(int parts) const {
+    size_t total = 0;
+    for (auto const& links : adjacency) {
+        total += 1 + links.size();
+    }
+    vector<int> partitions(adjacency.size());
+    size_t weight = 0;
+    for (size_t node = 0; node < adjacency.size(); node++) {
+        // The part the middle of this node's weight falls in
+        size_t middle = 2 * weight + 1 + adjacency[node].size();
+        partitions[node] = static_cast<int>(middle * parts / (2 * total));
+        weight += 1 + adjacency[node].size();
+    }
+    return partitions;
+}
+
+/*
+ * Pick `count` random existing links and give each a new cost in
+ * [minCost, maxCost] at a random time in [100, 1000), sorted by time.
+ * Pass the simulator's INFINITY as both costs to make the links fail.
+ */
+vector<LinkChange> Topology::randomChanges(int count,
+                                           int minCost,
+                                           int maxCost,
+                                           unsigned long seed) const {
+    vector<LinkChange> changes;
+    mt19937_64 rng{ seed };
+    uniform_int_distribution<int> randomNode{ 0, numNodes() - 1 };
+    uniform_int_distribution<int> randomCost{ minCost, maxCost };
+    uniform_int_distribution<int> randomTime{ 100, 999 };
+    for (int i = 0; i < count; i++) {
+        int from = randomNode(rng);
+        auto const& links = adjacency[from];
+        if (links.empty()) {
+            continue;
+        }
+        uniform_int_distribution<size_t> randomLink{ 0, links.size() - 1 };
+        int to = links[randomLink(rng)].first;
+        int cost = randomCost(rng);
+        double time = randomTime(rng);
+        changes.push_back({ time, from, to, cost });
+    }
+    sort(changes.begin(),
+         changes.end(),
+         [](LinkChange const& a, LinkChange const& b) {
+             return a.time < b.time;
+         });
+    return changes;
+}
+
+/*
+ * Append the adjacency lists to a snapshot
+ */
+void Topology::save(SnapshotWriter& snapshot) const {
+    snapshot.put<int>(numNodes());
+    for (auto const& links : adjacency) {
+        snapshot.putVector(links);
+    }
+}
+
+/*
+ * Read a topology written by Topology::save
+ */
+Topology Topology::restore(SnapshotReader& snapshot) {
+    Topology topology{ snapshot.get<int>() };
+    for (auto& links : topology.adjacency) {
+        links = snapshot.getVector<pair<int, int>>();
+    }
+    return topology;
+}
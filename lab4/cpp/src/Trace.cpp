@@ -0,0 +1,165 @@
+#include "Trace.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Bytes collected before they are written to the file
+const size_t TRACE_BUFFER_SIZE = 1 << 20;
+
+/*
+ * Start a trace of a simulation of `numNodes` nodes at `path`, with the
+ * packet contents at `path`.payload
+ */
+TraceWriter::TraceWriter(string const& path, int numNodes)
+    : records{ path }, payloads{ path + ".payload" } {
+    TraceHeader header{
+        TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord), numNodes
+    };
+    records.write(&header, sizeof(header));
+    header.magic = TRACE_PAYLOAD_MAGIC;
+    payloads.write(&header, sizeof(header));
+}
+
+TraceWriter::~TraceWriter() {
+    flush();
+}
+
+void TraceWriter::record(TraceRecord const& record) {
+    records.write(&record, sizeof(record));
+}
+
+/*
+ * Append `bytes` bytes of packet contents and return where they start
+ */
+uint64_t TraceWriter::payload(void const* data, size_t bytes) {
+    uint64_t offset = payloads.written;
+    payloads.write(data, bytes);
+    return offset;
+}
+
+/*
+ * Write out everything traced so far
+ */
+void TraceWriter::flush() {
+    records.flush();
+    payloads.flush();
+}
+
+TraceWriter::Output::Output(string const& path)
+    : path{ path }, file{ path, ios::binary | ios::trunc } {
+    if (!file) {
+        cerr << "Panic: could not open trace " << path << endl;
+        exit(1);
+    }
+    buffer.reserve(TRACE_BUFFER_SIZE);
+}
+
+void TraceWriter::Output::write(void const* data, size_t bytes) {
+    if (buffer.size() + bytes > TRACE_BUFFER_SIZE) {
+        flush();
+    }
+    char const* start = static_cast<char const*>(data);
+    buffer.insert(buffer.end(), start, start + bytes);
+    written += bytes;
+}
+
+void TraceWriter::Output::flush() {
+    file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    file.flush();
+    if (!file) {
+        cerr << "Panic: could not write trace " << path << endl;
+        exit(1);
+    }
+    buffer.clear();
+}
+
+/*
+ * Open the trace at `path` written by TraceWriter
+ */
+TraceReader::TraceReader(string const& path)
+    : records{ path }, payloads{ path + ".payload" },
+      offset{ sizeof(TraceHeader) } {
+    TraceHeader payloadHeader;
+    if (records.size < sizeof(header) || payloads.size < sizeof(header)) {
+        cerr << "Panic: trace " << path << " is truncated" << endl;
+        exit(1);
+    }
+    memcpy(&header, records.data, sizeof(header));
+    memcpy(&payloadHeader, payloads.data, sizeof(payloadHeader));
+    if (header.magic != TRACE_MAGIC ||
+        payloadHeader.magic != TRACE_PAYLOAD_MAGIC ||
+        header.version != TRACE_VERSION ||
+        header.recordSize != sizeof(TraceRecord)) {
+        cerr << "Panic: " << path << " is not a trace of this version" << endl;
+        exit(1);
+    }
+}
+
+TraceHeader const& TraceReader::getHeader() const {
+    return header;
+}
+
+/*
+ * Read the next record, false at the end of the trace
+ */
+bool TraceReader::next(TraceRecord& record) {
+    if (records.size - offset < sizeof(record)) {
+        return false;
+    }
+    memcpy(&record, records.data + offset, sizeof(record));
+    offset += sizeof(record);
+    return true;
+}
+
+/*
+ * The `count` ints of packet contents at `offset` in the payload file
+ */
+vector<int> TraceReader::payloadInts(uint64_t offset, size_t count) const {
+    if (offset > payloads.size ||
+        count > (payloads.size - offset) / sizeof(int)) {
+        cerr << "Panic: trace " << payloads.path << " is truncated" << endl;
+        exit(1);
+    }
+    vector<int> values(count);
+    if (count > 0) {
+        memcpy(values.data(), payloads.data + offset, count * sizeof(int));
+    }
+    return values;
+}
+
+TraceReader::Mapping::Mapping(string const& path) : path{ path } {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        cerr << "Panic: could not open trace " << path << endl;
+        exit(1);
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            cerr << "Panic: could not map trace " << path << endl;
+            exit(1);
+        }
+        data = static_cast<char const*>(mapped);
+    }
+    close(fd);
+}
+
+TraceReader::Mapping::~Mapping() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
@@ -0,0 +1,108 @@
+#include "Trace.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+/******************************************************************************
+ * Renders a binary trace written with RouterSimulator --tracefile as text.
+ *
+ * The lines are those RouterSimulator prints with --trace 3, without the
+ * distance tables: a MAIN line for every simulated event with the contents
+ * of the packet that arrived, and TOLAYER2 lines for every packet sent.
+ * Link-state advertisements also show their origin and sequence, and sent
+ * packets the time they arrive. Packets the link model lost or dropped get a
+ * TOLAYER2 line with the reason instead.
+ *
+ * Usage: ./TraceDecoder <trace>
+ * ***************************************************************************/
+
+using namespace std;
+
+/*
+ * Print the contents of the packet of `record`, with `before` and `after`
+ * around every entry as in the simulator's own trace
+ */
+static void printContents(TraceReader const& trace,
+                          TraceRecord const& record,
+                          char const* before,
+                          char const* after) {
+    size_t entries = static_cast<size_t>(record.entries);
+    if (record.format == TRACE_COSTS) {
+        for (int cost : trace.payloadInts(record.payload, entries)) {
+            cout << before << cost << after;
+        }
+        return;
+    }
+    uint64_t offset = record.payload;
+    if (record.format == TRACE_LSA) {
+        vector<int> header = trace.payloadInts(offset, 2);
+        cout << before << "origin:" << header[0] << " seq:" << header[1]
+             << after;
+        offset += 2 * sizeof(int);
+    }
+    vector<int> changes = trace.payloadInts(offset, 2 * entries);
+    for (size_t i = 0; i < entries; i++) {
+        cout << before << changes[2 * i] << ':' << changes[2 * i + 1] << after;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        cerr << "Usage: " << argv[0] << " <trace>" << endl;
+        return EXIT_FAILURE;
+    }
+    TraceReader trace{ argv[1] };
+    cout << "Trace of " << trace.getHeader().numNodes << " nodes\n";
+    cout << fixed << setprecision(6);
+
+    TraceRecord record;
+    while (trace.next(record)) {
+        switch (record.type) {
+        case TRACE_RECV: {
+            cout << "MAIN: rcv event, t=" << record.time << " at "
+                 << record.dst << '\n';
+            cout << " src:" << record.src << " dest:" << record.dst
+                 << ", contents:";
+            printContents(trace, record, " ", "");
+            cout << '\n';
+        } break;
+        case TRACE_LINK_CHANGE: {
+            cout << "MAIN: rcv event, t=" << record.time << " at "
+                 << record.src << '\n';
+            cout << " link " << record.src << "-" << record.dst
+                 << " changes cost to " << record.entries << '\n';
+        } break;
+        case TRACE_TIMER: {
+            cout << "MAIN: rcv event, t=" << record.time << " at "
+                 << record.src << '\n';
+            cout << " timer " << record.entries << " expired\n";
+        } break;
+        case TRACE_SEND: {
+            cout << "    TOLAYER2: source: " << record.src
+                 << " dest: " << record.dst << " entries: " << record.entries
+                 << " bytes: " << record.bytes << " costs:";
+            printContents(trace, record, "", " ");
+            cout << '\n';
+            cout << "    TOLAYER2: scheduling arrival on other side at t="
+                 << record.arrival << '\n';
+        } break;
+        case TRACE_DROP: {
+            cout << "    TOLAYER2: source: " << record.src
+                 << " dest: " << record.dst << " bytes: " << record.bytes
+                 << '\n';
+            cout << (record.entries == TRACE_LOST
+                         ? "    TOLAYER2: packet lost on the link\n"
+                         : "    TOLAYER2: link queue full, dropping packet\n");
+        } break;
+        default: {
+            cerr << "Panic: unknown trace record type " << record.type
+                 << endl;
+            exit(1);
+        }
+        }
+    }
+}